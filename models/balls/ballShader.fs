@@ -4,8 +4,9 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
-
-uniform sampler2D texture_diffuse1;
+in vec3 LocalPos;
+in vec4 BallColor;
+flat in float Striped;
 
 
 struct Material {
@@ -15,38 +16,48 @@ struct Material {
     float shininess;
 };
 
-struct Light {
-    vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+// shared by all programs, updated once per frame (see uniform_buffer.h)
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
 };
 
-uniform vec3 viewPos;
+layout (std140) uniform LightBlock {
+    vec4 position;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 color;
+} light;
+
 uniform Material material;
-uniform Light light;
 
 void main()
 {
-    // retrieve the texture color
-    vec4 texColor = texture(texture_diffuse1, TexCoords);
+    // ball colour: striped balls are white away from their equator, every ball has a white number disc facing +z
+    vec4 texColor = BallColor;
+    if (Striped > 0.5 && abs(LocalPos.y) > 0.5)
+        texColor = vec4(1.0);
+    if (LocalPos.z > 0.0 && length(LocalPos.xy) < 0.35)
+        texColor = vec4(1.0);
 
     // ambient
-    vec3 ambient = light.ambient * material.ambient;
+    vec3 ambient = light.ambient.rgb * material.ambient;
 
 
     // diffuse
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 lightDir = normalize(light.position.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    vec3 diffuse = light.diffuse.rgb * (diff * material.diffuse);
 
     // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);
+    vec3 specular = light.specular.rgb * (spec * material.specular);
 
     // calculate the final color
     vec3 result = (ambient + diffuse + specular) * vec3(texColor);
@@ -1,20 +1,32 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+#include "../common/vertexFormat.glsl"
+
+// per-instance attributes (see instance_buffer.h)
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in vec4 aInstanceColor;
+layout (location = 12) in vec4 aInstanceParams; // x = ball number, y = 1 for striped balls
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
+out vec3 LocalPos;
+out vec4 BallColor;
+flat out float Striped;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// shared by all programs, updated once per frame (see uniform_buffer.h)
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main()
 {
-    TexCoords = aTexCoords;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = vertexTexCoords();
+    LocalPos = vertexPosition();
+    BallColor = aInstanceColor;
+    Striped = aInstanceParams.y;
+    Normal = mat3(transpose(inverse(aInstanceModel))) * vertexNormal();
+    FragPos = vec3(aInstanceModel * vec4(vertexPosition(), 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
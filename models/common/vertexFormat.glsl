@@ -0,0 +1,49 @@
+// Vertex attributes of Mesh (see src/vertex_format.h). Programs drawing compact meshes are compiled with
+// COMPACT_VERTEX defined and decode the packed attributes here; otherwise the full float attributes are read as is.
+
+// per-mesh dequantization ranges of the compact attributes (unused by the full ones)
+#ifdef PER_DRAW_QUANTIZATION
+// assigned by the including shader from its per-draw data before the accessors run
+vec3 positionScale;
+vec3 positionOffset;
+vec4 texCoordTransform; // xy = offset, zw = scale
+#else
+// set by Mesh
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform vec4 texCoordTransform; // xy = offset, zw = scale
+#endif
+
+#ifdef COMPACT_VERTEX
+layout (location = 0) in vec4 aPackedPosition; // xyz within the mesh bounds, w = bitangent sign
+layout (location = 1) in vec2 aPackedNormal;   // octahedral
+layout (location = 2) in vec2 aPackedTexCoords;
+layout (location = 3) in vec2 aPackedTangent;  // octahedral
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 vertexPosition()  { return aPackedPosition.xyz * positionScale + positionOffset; }
+vec3 vertexNormal()    { return octDecode(aPackedNormal); }
+vec2 vertexTexCoords() { return aPackedTexCoords * texCoordTransform.zw + texCoordTransform.xy; }
+vec3 vertexTangent()   { return octDecode(aPackedTangent); }
+vec3 vertexBitangent() { return cross(vertexNormal(), vertexTangent()) * sign(aPackedPosition.w); }
+#else
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+vec3 vertexPosition()  { return aPos; }
+vec3 vertexNormal()    { return aNormal; }
+vec2 vertexTexCoords() { return aTexCoords; }
+vec3 vertexTangent()   { return aTangent; }
+vec3 vertexBitangent() { return aBitangent; }
+#endif
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;   // pixels, origin at the top left
+layout (location = 1) in vec4 aColor;
+
+out vec4 Color;
+
+uniform vec2 screenSize;
+uniform float scale;
+
+void main()
+{
+    vec2 pixel = aPos * scale;
+    gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+    Color = aColor;
+}
@@ -1,20 +1,23 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+#include "../common/vertexFormat.glsl"
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// shared by all programs, updated once per frame (see uniform_buffer.h)
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main()
 {
-    TexCoords = aTexCoords;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = vertexTexCoords();
+    Normal = mat3(transpose(inverse(model))) * vertexNormal();
+    FragPos = vec3(model * vec4(vertexPosition(), 1.0));
+    gl_Position = projection * view * model * vec4(vertexPosition(), 1.0);
 }
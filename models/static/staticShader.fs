@@ -0,0 +1,63 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in float Layer;
+
+// diffuse textures of the static scene, one layer each (see static_scene.h); Layer is -1 for untextured meshes
+uniform sampler2DArray materials;
+
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+// shared by all programs, updated once per frame (see uniform_buffer.h)
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+
+layout (std140) uniform LightBlock {
+    vec4 position;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 color;
+} light;
+
+uniform Material material;
+
+void main()
+{
+    // retrieve the texture color
+    vec4 texColor = Layer < 0.0 ? vec4(1.0) : texture(materials, vec3(TexCoords, Layer));
+
+    // ambient
+    vec3 ambient = light.ambient.rgb * material.ambient;
+
+
+    // diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(light.position.xyz - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse.rgb * (diff * material.diffuse);
+
+    // specular
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specular = light.specular.rgb * (spec * material.specular);
+
+    // calculate the final color
+    vec3 result = (ambient + diffuse + specular) * vec3(texColor);
+    FragColor = vec4(result, 1.0) * texColor;
+}
+
@@ -0,0 +1,50 @@
+#version 330 core
+#define PER_DRAW_QUANTIZATION
+#include "../common/vertexFormat.glsl"
+
+// index of the draw in the static batch (see static_scene.h): the command's baseInstance in the multi-draw path,
+// a uniform set before every draw otherwise
+#ifdef DRAW_ID_UNIFORM
+uniform int drawId;
+#else
+layout (location = 13) in uint aDrawId;
+#endif
+
+// 10 texels per draw: model matrix, normal matrix, position scale + texture layer, position offset, texture
+// coordinate transform
+uniform samplerBuffer drawData;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+flat out float Layer;
+
+// shared by all programs, updated once per frame (see uniform_buffer.h)
+layout (std140) uniform CameraBlock {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+
+void main()
+{
+#ifdef DRAW_ID_UNIFORM
+    int base = drawId * 10;
+#else
+    int base = int(aDrawId) * 10;
+#endif
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz,
+                             texelFetch(drawData, base + 6).xyz);
+    vec4 scaleLayer = texelFetch(drawData, base + 7);
+    positionScale = scaleLayer.xyz;
+    positionOffset = texelFetch(drawData, base + 8).xyz;
+    texCoordTransform = texelFetch(drawData, base + 9);
+    Layer = scaleLayer.w;
+
+    TexCoords = vertexTexCoords();
+    Normal = normalMatrix * vertexNormal();
+    FragPos = vec3(model * vec4(vertexPosition(), 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,748 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <camera.h>
+#include <geometry_arena.h>
+#include <gpu_timer.h>
+#include <instance_buffer.h>
+#include <model.h>
+#include <shader.h>
+#include <shot_search.h>
+#include <static_scene.h>
+#include <thread_pool.h>
+#include <uniform_buffer.h>
+#include <vertex_convert.h>
+
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Benchmarks run from the command line (see main.cpp); they need a current GL context and print their results to stdout.
+namespace Benchmark
+{
+    inline double elapsedMs(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    inline void arenaStats(const string &label, const GeometryArena &arena)
+    {
+        GeometryArena::Stats stats = arena.stats();
+        cout << "  " << label << ": " << stats.ranges << " meshes, vertices " << stats.vertexUsed / 1024.0 << " of "
+             << stats.vertexCapacity / 1024.0 << " KiB in use (" << stats.vertexFreeBlocks << " free blocks, "
+             << stats.vertexFragmentation * 100.0f << "% fragmented), indices " << stats.indexUsed / 1024.0 << " of "
+             << stats.indexCapacity / 1024.0 << " KiB in use (" << stats.indexFreeBlocks << " free blocks, "
+             << stats.indexFragmentation * 100.0f << "% fragmented)" << endl;
+    }
+
+    inline void textureStats()
+    {
+        TextureCache::Stats stats = TextureCache::shared().stats();
+        cout << "  textures: " << stats.textures << " shared by " << stats.references << " references, "
+             << stats.bytes / 1024.0 << " KiB; " << stats.pathHits << " shared by path and " << stats.contentHits
+             << " by content so far, " << stats.bytesSaved / 1024.0 << " KiB of uploads saved" << endl;
+    }
+
+    // compares a cold load (Assimp import, which also refreshes the mesh cache) with a warm load from the mesh cache, and
+    // the GPU vertex memory of the full and compact vertex layouts
+    inline void startup(const vector<string> &modelPaths)
+    {
+        double coldTotal = 0.0, warmTotal = 0.0;
+        size_t fullVertexBytes = 0, compactVertexBytes = 0;
+        cout << fixed << setprecision(2);
+        cout << "startup benchmark (cold = Assimp import, warm = mesh cache)" << endl;
+        for (const string &path : modelPaths)
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            {
+                Model cold(path, false, false);
+            }
+            double coldMs = elapsedMs(start);
+
+            start = chrono::steady_clock::now();
+            bool hit;
+            size_t compactBytes;
+            {
+                Model warm(path);
+                hit = warm.loadedFromCache;
+                compactBytes = warm.vertexBufferSize();
+            }
+            double warmMs = elapsedMs(start);
+
+            size_t fullBytes;
+            {
+                Model full(path, false, true, VERTEX_FULL);
+                fullBytes = full.vertexBufferSize();
+            }
+
+            coldTotal += coldMs;
+            warmTotal += warmMs;
+            fullVertexBytes += fullBytes;
+            compactVertexBytes += compactBytes;
+            cout << "  " << path << ": cold " << coldMs << " ms, warm " << warmMs << " ms"
+                 << (hit ? "" : " (cache miss)") << ", vertices " << fullBytes / 1024.0 << " KiB full, "
+                 << compactBytes / 1024.0 << " KiB compact" << endl;
+        }
+        cout << "  total: cold " << coldTotal << " ms, warm " << warmTotal << " ms, speedup "
+             << (warmTotal > 0.0 ? coldTotal / warmTotal : 0.0) << "x" << endl;
+        cout << "  vertex buffers: full " << fullVertexBytes / 1024.0 << " KiB, compact " << compactVertexBytes / 1024.0
+             << " KiB (" << (compactVertexBytes > 0 ? double(fullVertexBytes) / compactVertexBytes : 0.0) << "x smaller)" << endl;
+
+        // all models loaded together, then with one released from the middle of the arena
+        {
+            vector<unique_ptr<Model>> models;
+            for (const string &path : modelPaths)
+                models.emplace_back(new Model(path));
+            arenaStats("arena with every model", GeometryArena::forLayout(VERTEX_COMPACT));
+            textureStats();
+            if (models.size() > 2)
+            {
+                models[1].reset();
+                arenaStats("arena after releasing " + modelPaths[1], GeometryArena::forLayout(VERTEX_COMPACT));
+            }
+        }
+    }
+
+    struct ShaderSource {
+        string vertexPath, fragmentPath, defines;
+    };
+
+    // compiling and linking every program from source against taking it from the program binary cache
+    inline void programs(const vector<ShaderSource> &shaders)
+    {
+        cout << fixed << setprecision(2);
+        if (!ProgramCache::supported())
+        {
+            cout << "program cache: no program binary formats, programs are always compiled" << endl;
+            return;
+        }
+        bool wasEnabled = ProgramCache::enabled();
+        double coldTotal = 0.0, warmTotal = 0.0;
+        cout << "program benchmark (cold = compile and link, warm = program binary cache)" << endl;
+        for (const ShaderSource &source : shaders)
+        {
+            ProgramCache::enabled() = false;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            {
+                Shader cold(source.vertexPath.c_str(), source.fragmentPath.c_str(), source.defines);
+                glFinish();
+            }
+            double coldMs = elapsedMs(start);
+
+            // the first cached build writes the binary (unless it is there already), the second one reads it
+            ProgramCache::enabled() = true;
+            {
+                Shader fill(source.vertexPath.c_str(), source.fragmentPath.c_str(), source.defines);
+            }
+            start = chrono::steady_clock::now();
+            bool hit;
+            {
+                Shader warm(source.vertexPath.c_str(), source.fragmentPath.c_str(), source.defines);
+                glFinish();
+                hit = warm.loadedFromCache;
+            }
+            double warmMs = elapsedMs(start);
+
+            coldTotal += coldMs;
+            warmTotal += warmMs;
+            cout << "  " << source.vertexPath << ": cold " << coldMs << " ms, warm " << warmMs << " ms"
+                 << (hit ? "" : " (cache miss)") << endl;
+        }
+        ProgramCache::enabled() = wasEnabled;
+        cout << "  total: cold " << coldTotal << " ms, warm " << warmTotal << " ms, speedup "
+             << (warmTotal > 0.0 ? coldTotal / warmTotal : 0.0) << "x" << endl;
+    }
+
+    // loading every texture of the models from its image (decode, upload, generated mipmaps) against from the .dds
+    // written by TextureConvert (read, compressed upload of the stored chain): time to a finished upload, the decoded
+    // bytes held on the CPU and the estimated GPU memory. Then the models are loaded into a StaticScene both ways, for the
+    // memory of the texture arrays that are actually drawn
+    inline void textures(const vector<string> &modelPaths)
+    {
+        bool wasEnabled = Dds::enabled();
+        double imageTotal = 0.0, compressedTotal = 0.0;
+        size_t imageCpu = 0, compressedCpu = 0, imageGpu = 0, compressedGpu = 0, missing = 0;
+        cout << fixed << setprecision(2);
+        cout << "texture benchmark (image = stb_image decode and glGenerateMipmap, dds = block-compressed mip chain)" << endl;
+        for (const string &modelPath : modelPaths)
+        {
+            ModelSource source;
+            Model::read(modelPath, true, VERTEX_COMPACT, source);
+            for (const string &file : source.texturePaths)
+            {
+                Dds::enabled() = false;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                DecodedImage image = DecodeImage(file.c_str(), source.directory);
+                size_t cpuBytes = image.bytes(), gpuBytes = cpuBytes * 4 / 3;
+                GLuint texture = UploadTexture(image, file.c_str());
+                glFinish();
+                double imageMs = elapsedMs(start);
+                glDeleteTextures(1, &texture);
+                GLState::current().forgetTexture(texture);
+
+                Dds::enabled() = true;
+                start = chrono::steady_clock::now();
+                DecodedImage compressed = DecodeImage(file.c_str(), source.directory);
+                bool hit = compressed.compressedFormat != 0;
+                size_t compressedBytes = compressed.bytes();
+                texture = UploadTexture(compressed, file.c_str());
+                glFinish();
+                double compressedMs = elapsedMs(start);
+                glDeleteTextures(1, &texture);
+                GLState::current().forgetTexture(texture);
+
+                cout << "  " << source.directory << '/' << file << ": image " << imageMs << " ms, " << gpuBytes / 1024.0 << " KiB";
+                if (!hit)
+                {
+                    missing++;
+                    cout << "; no .dds (run TextureConvert)" << endl;
+                    continue;
+                }
+                cout << "; dds " << compressedMs << " ms, " << compressedBytes / 1024.0 << " KiB" << endl;
+                imageTotal += imageMs;
+                compressedTotal += compressedMs;
+                imageCpu += cpuBytes;
+                compressedCpu += compressedBytes;
+                imageGpu += gpuBytes;
+                compressedGpu += compressedBytes;
+            }
+        }
+        Dds::enabled() = wasEnabled;
+        cout << "  total of the textures with a .dds: image " << imageTotal << " ms, dds " << compressedTotal << " ms, speedup "
+             << (compressedTotal > 0.0 ? imageTotal / compressedTotal : 0.0) << "x" << endl;
+        cout << "  memory: decoded " << imageCpu / 1024.0 << " KiB against " << compressedCpu / 1024.0 << " KiB read, GPU "
+             << imageGpu / 1024.0 << " KiB against " << compressedGpu / 1024.0 << " KiB ("
+             << (compressedGpu > 0 ? double(imageGpu) / compressedGpu : 0.0) << "x smaller)" << endl;
+        if (missing > 0)
+            cout << "  " << missing << " textures have no .dds and were left out of the totals" << endl;
+
+        size_t arrays[2], arrayBytes[2];
+        for (int compressed = 0; compressed < 2; compressed++)
+        {
+            Dds::enabled() = compressed != 0;
+            // declared first, so the scene is gone before the models it points into
+            vector<unique_ptr<Model>> models;
+            StaticScene scene(VERTEX_COMPACT, false);
+            for (const string &modelPath : modelPaths)
+            {
+                models.emplace_back(new Model(modelPath));
+                scene.add(*models.back(), glm::mat4(1.0f));
+            }
+            scene.build();
+            glFinish();
+            arrays[compressed] = scene.materialArrayCount();
+            arrayBytes[compressed] = scene.materialBytes();
+        }
+        Dds::enabled() = wasEnabled;
+        cout << "  drawn (static scene texture arrays): image " << arrays[0] << " arrays, " << arrayBytes[0] / 1024.0
+             << " KiB; dds " << arrays[1] << " arrays, " << arrayBytes[1] / 1024.0 << " KiB ("
+             << (arrayBytes[1] > 0 ? double(arrayBytes[0]) / arrayBytes[1] : 0.0) << "x smaller)" << endl;
+    }
+
+    // importing each OBJ model (without the mesh cache) through Assimp against ObjParser on one thread and on the whole
+    // pool, neither followed by MeshOptimizer or the levels of detail, so only the importers are compared; the best of a
+    // few runs each
+    inline void objImport(const vector<string> &modelPaths)
+    {
+        const int RUNS = 5;
+        bool wasEnabled = ObjParser::enabled();
+        auto best = [&](const function<void()> &import) {
+            double fastest = 0.0;
+            for (int run = 0; run < RUNS; run++)
+            {
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                import();
+                double ms = elapsedMs(start);
+                fastest = run == 0 ? ms : std::min(fastest, ms);
+            }
+            return fastest;
+        };
+
+        cout << fixed << setprecision(2);
+        cout << "OBJ import benchmark (best of " << RUNS << " runs)" << endl;
+        for (const string &path : modelPaths)
+        {
+            size_t assimpVertices = 0, parserVertices = 0, meshCount = 0;
+            ObjParser::enabled() = false;
+            double assimpMs = best([&] {
+                ModelSource source;
+                Model::import(path, VERTEX_COMPACT, source, nullptr, false);
+                assimpVertices = 0;
+                for (const MeshCache::CachedMesh &mesh : source.meshes)
+                    assimpVertices += mesh.vertices.size();
+            });
+            ObjParser::enabled() = wasEnabled;
+            vector<MeshCache::CachedMesh> meshes;
+            bool parsed = true;
+            double singleMs = best([&] { parsed = ObjParser::read(path, meshes, 1) && parsed; });
+            double poolMs = best([&] { parsed = ObjParser::read(path, meshes) && parsed; });
+            meshCount = meshes.size();
+            for (const MeshCache::CachedMesh &mesh : meshes)
+                parserVertices += mesh.vertices.size();
+
+            ObjParser::MappedFile file;
+            double megabytes = file.open(path) ? (file.end() - file.begin()) / (1024.0 * 1024.0) : 0.0;
+            cout << "  " << path << " (" << megabytes << " MiB): Assimp " << assimpMs << " ms, " << assimpVertices << " vertices; ";
+            if (!parsed)
+            {
+                cout << "not in the subset ObjParser reads" << endl;
+                continue;
+            }
+            cout << "ObjParser " << singleMs << " ms on 1 thread, " << poolMs << " ms on " << ThreadPool::shared().size()
+                 << " (" << megabytes * 1000.0 / poolMs << " MiB/s), " << meshCount << " meshes, " << parserVertices
+                 << " vertices; " << assimpMs / poolMs << "x faster" << endl;
+        }
+    }
+
+    // what MeshOptimizer does to each mesh of the models: ACMR (vertex shader runs per triangle) and ATVR (runs per
+    // vertex) with a CACHE_SIZE-entry FIFO, and overdraw, as imported, after welding and the vertex cache order and after
+    // all passes; plus the time the passes add to an import (best of a few runs)
+    inline void meshOptimizer(const vector<string> &modelPaths)
+    {
+        const int RUNS = 3;
+        bool wasEnabled = MeshOptimizer::enabled();
+        cout << fixed << setprecision(3);
+        cout << "mesh optimizer benchmark (" << MeshOptimizer::CACHE_SIZE << "-entry vertex cache; ACMR / ATVR / overdraw: imported -> welded in "
+             << "vertex cache order -> all passes)" << endl;
+        for (const string &path : modelPaths)
+        {
+            ModelSource source;
+            MeshOptimizer::enabled() = false;
+            bool imported = Model::import(path, VERTEX_COMPACT, source);
+            MeshOptimizer::enabled() = wasEnabled;
+            if (!imported)
+                continue;
+
+            double fastest = 0.0;
+            for (int run = 0; run < RUNS; run++)
+            {
+                vector<MeshCache::CachedMesh> meshes = source.meshes;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                MeshOptimizer::optimize(meshes);
+                double ms = elapsedMs(start);
+                fastest = run == 0 ? ms : std::min(fastest, ms);
+            }
+
+            cout << "  " << path << ": " << fastest << " ms for " << source.meshes.size() << " meshes" << endl;
+            size_t totalTriangles = 0, importedVertices = 0, optimizedVertices = 0;
+            double totals[3][2] = {};
+            for (size_t m = 0; m < source.meshes.size(); m++)
+            {
+                const MeshCache::CachedMesh &mesh = source.meshes[m];
+                size_t triangles = mesh.indices.size() / 3;
+                if (triangles == 0)
+                    continue;
+                MeshCache::CachedMesh welded = mesh, optimized = mesh;
+                MeshOptimizer::weld(welded);
+                welded.indices = MeshOptimizer::vertexCacheOrder(welded.indices, welded.vertices.size());
+                MeshOptimizer::optimize(optimized);
+                const MeshCache::CachedMesh *stages[3] = { &mesh, &welded, &optimized };
+
+                cout << "    mesh " << m << " (" << triangles << " triangles, " << mesh.vertices.size() << " -> "
+                     << optimized.vertices.size() << " vertices):";
+                for (int stage = 0; stage < 3; stage++)
+                {
+                    const MeshCache::CachedMesh &result = *stages[stage];
+                    float acmr = MeshOptimizer::acmr(result.indices, result.vertices.size());
+                    float overdraw = MeshOptimizer::overdraw(result.vertices, result.indices);
+                    cout << (stage == 0 ? " " : " -> ") << acmr << " / " << acmr * triangles / result.vertices.size() << " / " << overdraw;
+                    totals[stage][0] += acmr * triangles;
+                    totals[stage][1] += overdraw * triangles;
+                }
+                cout << endl;
+                totalTriangles += triangles;
+                importedVertices += mesh.vertices.size();
+                optimizedVertices += optimized.vertices.size();
+            }
+            if (totalTriangles == 0)
+                continue;
+            cout << "    all meshes: " << importedVertices << " -> " << optimizedVertices << " vertices, per triangle";
+            for (int stage = 0; stage < 3; stage++)
+                cout << (stage == 0 ? " ACMR " : " -> ") << totals[stage][0] / totalTriangles;
+            for (int stage = 0; stage < 3; stage++)
+                cout << (stage == 0 ? ", overdraw " : " -> ") << totals[stage][1] / totalTriangles;
+            cout << endl;
+        }
+    }
+
+    // the levels of detail MeshSimplifier builds for a model, and what they save: a grid of GRID x GRID instances of it,
+    // scaled by `scale` and facing `camera`, drawn from further and further away with the full meshes and with the level
+    // Mesh::lodFor picks for the nearest instance (as main.cpp does for the balls). `shader` must be in use, with its
+    // uniform blocks bound.
+    inline void lod(const string &modelPath, Shader &shader, const Camera &camera, unsigned int width, unsigned int height, float scale)
+    {
+        const int GRID = 32, FRAMES = 200;
+        const float distances[] = { 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f };
+        Model model(modelPath);
+        cout << fixed << setprecision(3);
+        cout << "level of detail benchmark (" << GRID * GRID << " instances of " << modelPath << " at scale " << scale << ", "
+             << width << "x" << height << ", zoom " << camera.Zoom << ", " << FRAMES << " frames each)" << endl;
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            const Mesh &mesh = model.meshes[m];
+            cout << "  mesh " << m << ": " << mesh.range.indexCount / 3 << " triangles";
+            for (size_t level = 0; level < mesh.lods.size(); level++)
+                cout << " -> " << mesh.lods[level].indexCount / 3 << " (error " << mesh.lodErrors[level] << ")";
+            cout << endl;
+        }
+
+        // the instances in a plane facing the camera, three radii apart, the nearest one in the middle
+        vector<InstanceData> instances;
+        for (int y = 0; y < GRID; y++)
+            for (int x = 0; x < GRID; x++)
+            {
+                glm::vec3 position = glm::vec3(x - GRID / 2, y - GRID / 2, 0.0f) * (3.0f * scale);
+                InstanceData instance;
+                instance.model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale));
+                instance.color = glm::vec4(0.8f, 0.05f, 0.05f, 1.0f);
+                instance.params = glm::vec4(static_cast<float>(x % 16), 0.0f, 0.0f, 0.0f);
+                instances.push_back(instance);
+            }
+        InstanceBuffer instanceBuffer;
+        instanceBuffer.update(instances);
+        UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+        UniformBuffer<LightBlock> lightBuffer(LIGHT_BLOCK_BINDING);
+        LightBlock light;
+        light.position = glm::vec4(0.0f, 4.0f, 4.0f, 1.0f);
+        light.ambient = glm::vec4(0.7f, 0.7f, 0.7f, 0.0f);
+        light.diffuse = light.specular = light.color = glm::vec4(1.0f);
+        lightBuffer.update(light);
+        shader.use();
+        float pixelsPerUnit = camera.GetPixelsPerUnit(static_cast<float>(height)) * scale;
+
+        for (float distance : distances)
+        {
+            CameraBlock cameraData;
+            glm::vec3 eye(0.0f, 0.0f, distance + scale);
+            cameraData.projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(width) / height, 0.01f, 100.0f);
+            cameraData.view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            cameraData.viewPos = glm::vec4(eye, 1.0f);
+            cameraBuffer.update(cameraData);
+
+            // full meshes, then levels of detail: GPU ms per frame and frame ms (submission to glFinish)
+            double gpuMs[2], frameMs[2];
+            size_t triangles[2];
+            for (int pass = 0; pass < 2; pass++)
+            {
+                float unitPixels = pass == 0 ? FLT_MAX : pixelsPerUnit / distance;
+                triangles[pass] = model.triangleCount(unitPixels) * instances.size();
+                GpuTimer timer;
+                glFinish();
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int frame = 0; frame < FRAMES; frame++)
+                {
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    timer.begin();
+                    model.DrawInstanced(shader, instanceBuffer, unitPixels);
+                    timer.end();
+                }
+                glFinish();
+                frameMs[pass] = elapsedMs(start) / FRAMES;
+                timer.finish();
+                double total = 0.0;
+                size_t measured = 0;
+                for (double ms : timer.results)
+                    if (!std::isnan(ms))
+                    {
+                        total += ms;
+                        measured++;
+                    }
+                gpuMs[pass] = measured > 0 ? total / measured : 0.0;
+            }
+
+            size_t level = model.meshes.empty() ? 0 : model.meshes[0].lodFor(pixelsPerUnit / distance);
+            cout << "  " << setw(6) << distance << " m: level " << level << ", " << triangles[0] << " -> " << triangles[1]
+                 << " triangles, GPU " << gpuMs[0] << " -> " << gpuMs[1] << " ms, frame " << frameMs[0] << " -> " << frameMs[1]
+                 << " ms" << endl;
+        }
+    }
+
+    // vertices of `output` that differ, byte for byte, from `reference`
+    template<class T>
+    inline size_t differingVertices(const vector<vector<T>> &reference, const vector<vector<T>> &output)
+    {
+        size_t differing = 0;
+        for (size_t m = 0; m < reference.size(); m++)
+            for (size_t i = 0; i < reference[m].size(); i++)
+                if (memcmp(&reference[m][i], &output[m][i], sizeof(T)) != 0)
+                    differing++;
+        return differing;
+    }
+
+    // vertices per second of the import-time conversions on each model's meshes (Assimp's import itself is not timed):
+    // filling Vertex from the aiMesh arrays the old way, one vertex at a time through glm temporaries, against the
+    // stream-wise interleave, and quantizing to CompactVertex with each kernel the CPU supports
+    inline void vertices(const vector<string> &modelPaths)
+    {
+        using namespace VertexConvert;
+        const Kernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+        // repeats every conversion until it has run this long, for stable rates on small models
+        const double MIN_MS = 200.0;
+        auto rate = [&](size_t vertexCount, const function<void()> &convert) {
+            size_t runs = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            double ms;
+            do
+            {
+                convert();
+                runs++;
+            } while ((ms = elapsedMs(start)) < MIN_MS);
+            return vertexCount * runs / (ms / 1000.0) / 1.0e6;
+        };
+
+        cout << fixed << setprecision(1);
+        cout << "vertex conversion benchmark (million vertices per second)" << endl;
+        for (const string &path : modelPaths)
+        {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            if (!scene)
+            {
+                cout << "  " << path << ": " << importer.GetErrorString() << endl;
+                continue;
+            }
+            vector<AttributeStreams> streams;
+            size_t vertexCount = 0;
+            for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+            {
+                const aiMesh *mesh = scene->mMeshes[m];
+                if (mesh->mNumVertices == 0)
+                    continue;
+                bool hasTexCoords = mesh->mTextureCoords[0] != nullptr;
+                AttributeStreams stream = { &mesh->mVertices[0].x, mesh->HasNormals() ? &mesh->mNormals[0].x : nullptr,
+                                            hasTexCoords ? &mesh->mTextureCoords[0][0].x : nullptr,
+                                            hasTexCoords && mesh->mTangents ? &mesh->mTangents[0].x : nullptr,
+                                            hasTexCoords && mesh->mBitangents ? &mesh->mBitangents[0].x : nullptr, mesh->mNumVertices };
+                streams.push_back(stream);
+                vertexCount += mesh->mNumVertices;
+            }
+            vector<vector<Vertex>> converted(streams.size());
+            for (size_t m = 0; m < streams.size(); m++)
+                converted[m].resize(streams[m].count);
+
+            cout << "  " << path << " (" << vertexCount << " vertices)" << endl;
+            cout << "    interleave: per vertex " << rate(vertexCount, [&] {
+                for (size_t m = 0; m < streams.size(); m++)
+                {
+                    const aiMesh *mesh = scene->mMeshes[m];
+                    for (size_t i = 0; i < streams[m].count; i++)
+                    {
+                        Vertex &vertex = converted[m][i];
+                        glm::vec3 vector;
+                        vector.x = mesh->mVertices[i].x;
+                        vector.y = mesh->mVertices[i].y;
+                        vector.z = mesh->mVertices[i].z;
+                        vertex.Position = vector;
+                        if (mesh->HasNormals())
+                            vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                        if (mesh->mTextureCoords[0])
+                        {
+                            vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                            vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                            vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+                        }
+                    }
+                }
+            });
+            for (Kernel kernel : kernels)
+                if (available(kernel))
+                    cout << ", " << kernelName(kernel) << " " << rate(vertexCount, [&] {
+                        for (size_t m = 0; m < streams.size(); m++)
+                            interleave(streams[m], converted[m].data(), kernel);
+                    });
+            cout << endl;
+
+            // every kernel's output against the scalar one's, into zeroed buffers so fields no kernel writes compare equal
+            auto interleaved = [&](Kernel kernel) {
+                vector<vector<Vertex>> output(streams.size());
+                for (size_t m = 0; m < streams.size(); m++)
+                {
+                    output[m].resize(streams[m].count);
+                    memset(static_cast<void *>(output[m].data()), 0, output[m].size() * sizeof(Vertex));
+                    interleave(streams[m], output[m].data(), kernel);
+                }
+                return output;
+            };
+            vector<vector<Vertex>> reference = interleaved(KERNEL_SCALAR);
+            bool identical = true;
+            for (Kernel kernel : kernels)
+                if (kernel != KERNEL_SCALAR && available(kernel))
+                {
+                    size_t differing = differingVertices(reference, interleaved(kernel));
+                    identical = identical && differing == 0;
+                    if (differing > 0)
+                        cout << "    MISMATCH: interleave " << kernelName(kernel) << " differs from scalar in " << differing
+                             << " of " << vertexCount << " vertices" << endl;
+                }
+            // the compact kernels all start from the scalar kernel's vertices
+            converted = reference;
+
+            vector<VertexQuantization> quantizations;
+            vector<vector<CompactVertex>> packed(converted.size());
+            for (size_t m = 0; m < converted.size(); m++)
+            {
+                quantizations.push_back(quantizationFor(converted[m]));
+                packed[m].resize(converted[m].size());
+            }
+            cout << "    compact:";
+            for (Kernel kernel : kernels)
+                if (available(kernel))
+                    cout << (kernel == KERNEL_SCALAR ? " " : ", ") << kernelName(kernel) << " " << rate(vertexCount, [&] {
+                        for (size_t m = 0; m < converted.size(); m++)
+                            compact(converted[m].data(), converted[m].size(), quantizations[m], packed[m].data(), kernel);
+                    });
+            cout << endl;
+
+            auto compacted = [&](Kernel kernel) {
+                vector<vector<CompactVertex>> output(converted.size());
+                for (size_t m = 0; m < converted.size(); m++)
+                {
+                    output[m].resize(converted[m].size());
+                    memset(static_cast<void *>(output[m].data()), 0, output[m].size() * sizeof(CompactVertex));
+                    compact(converted[m].data(), converted[m].size(), quantizations[m], output[m].data(), kernel);
+                }
+                return output;
+            };
+            vector<vector<CompactVertex>> packedReference = compacted(KERNEL_SCALAR);
+            for (Kernel kernel : kernels)
+                if (kernel != KERNEL_SCALAR && available(kernel))
+                {
+                    size_t differing = differingVertices(packedReference, compacted(kernel));
+                    identical = identical && differing == 0;
+                    if (differing > 0)
+                        cout << "    MISMATCH: compact " << kernelName(kernel) << " differs from scalar in " << differing
+                             << " of " << vertexCount << " vertices" << endl;
+                }
+            if (identical)
+                cout << "    every kernel's output is identical to the scalar kernel's" << endl;
+        }
+    }
+
+    // per-frame cost of the ~40 uniform updates main.cpp used to do (13 uniforms for each of its 3 lit shaders) plus the sampler
+    // bindings of a few textured meshes: string lookups through glGetUniformLocation (the old path), name lookups in the
+    // uniform table and pre-resolved handles
+    inline void uniforms(Shader &shader)
+    {
+        const char *names[] = { "light.ambient", "light.diffuse", "light.specular", "light.position", "lightColor",
+                                "material.ambient", "material.diffuse", "material.specular", "material.shininess",
+                                "projection", "view", "model", "viewPos" };
+        // each uniform is set with the glUniform call matching its type: 0 = vec3, 1 = float, 2 = mat4
+        const int types[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 2, 2, 0 };
+        const size_t nameCount = sizeof(names) / sizeof(names[0]);
+        const int shadersPerFrame = 3, samplersPerFrame = 16, frames = 20000;
+        const glm::mat4 matrix(1.0f);
+        const glm::vec3 value(1.0f);
+
+        shader.use();
+        glFinish();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int s = 0; s < shadersPerFrame; s++)
+                for (size_t i = 0; i < nameCount; i++)
+                {
+                    if (types[i] == 2)
+                        glUniformMatrix4fv(glGetUniformLocation(shader.ID, names[i]), 1, GL_FALSE, glm::value_ptr(matrix));
+                    else if (types[i] == 1)
+                        glUniform1f(glGetUniformLocation(shader.ID, names[i]), value.x);
+                    else
+                        glUniform3f(glGetUniformLocation(shader.ID, names[i]), value.x, value.y, value.z);
+                }
+            // what Mesh::Draw used to do for every texture
+            for (int t = 0; t < samplersPerFrame; t++)
+            {
+                string name = "texture_diffuse";
+                glUniform1i(glGetUniformLocation(shader.ID, (name + std::to_string(1)).c_str()), 0);
+            }
+        }
+        glFinish();
+        double stringMs = elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int s = 0; s < shadersPerFrame; s++)
+                for (size_t i = 0; i < nameCount; i++)
+                {
+                    if (types[i] == 2)
+                        shader.setMatrix4(names[i], matrix);
+                    else if (types[i] == 1)
+                        shader.setFloat(names[i], value.x);
+                    else
+                        shader.setVector3f(names[i], value);
+                }
+            for (int t = 0; t < samplersPerFrame; t++)
+                shader.setInteger("texture_diffuse1", 0);
+        }
+        glFinish();
+        double tableMs = elapsedMs(start);
+
+        vector<Uniform> handles;
+        for (size_t i = 0; i < nameCount; i++)
+            handles.push_back(shader.uniform(names[i]));
+        Uniform sampler = shader.uniform("texture_diffuse1");
+        start = chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int s = 0; s < shadersPerFrame; s++)
+                for (size_t i = 0; i < nameCount; i++)
+                {
+                    if (types[i] == 2)
+                        shader.setMatrix4(handles[i], matrix);
+                    else if (types[i] == 1)
+                        shader.setFloat(handles[i], value.x);
+                    else
+                        shader.setVector3f(handles[i], value);
+                }
+            for (int t = 0; t < samplersPerFrame; t++)
+                shader.setInteger(sampler, 0);
+        }
+        glFinish();
+        double handleMs = elapsedMs(start);
+
+        int callsPerFrame = shadersPerFrame * static_cast<int>(nameCount) + samplersPerFrame;
+        cout << fixed << setprecision(3);
+        cout << "uniform benchmark: " << callsPerFrame << " uniform updates per frame, " << frames << " frames" << endl;
+        cout << "  glGetUniformLocation per call: " << stringMs * 1000.0 / frames << " us/frame" << endl;
+        cout << "  uniform table lookup:          " << tableMs * 1000.0 / frames << " us/frame" << endl;
+        cout << "  pre-resolved handles:          " << handleMs * 1000.0 / frames << " us/frame" << endl;
+    }
+
+    // shot search from the position after a break, every candidate evaluated (no time budget), on pools of 1, 2, 4, ...
+    // threads up to the hardware thread count, to show how the search scales with cores
+    inline void shotSearch()
+    {
+        EventSimulation simulation;
+        simulation.strike(0, 3.14159265f + 0.002f, 8.0f);
+        BallSet state;
+        simulation.sample(numeric_limits<double>::infinity(), state);
+
+        unsigned int hardwareThreads = max(1u, thread::hardware_concurrency());
+        double singleMs = 0.0;
+        cout << fixed << setprecision(2);
+        cout << "shot search benchmark (position after the break)" << endl;
+        for (unsigned int threads = 1;; threads = min(threads * 2, hardwareThreads))
+        {
+            ThreadPool pool(threads);
+            ShotSearch search(pool);
+            ShotSearchResult result = search.search(state, numeric_limits<double>::infinity());
+            if (threads == 1)
+                singleMs = result.milliseconds;
+            cout << "  " << threads << " threads: " << result.evaluated << " shots in " << result.milliseconds << " ms, "
+                 << result.evaluated * 1000.0 / result.milliseconds << " shots/s, speedup " << singleMs / result.milliseconds
+                 << "x, best score " << result.best.front().score << endl;
+            if (threads == hardwareThreads)
+                break;
+        }
+    }
+}
+#endif
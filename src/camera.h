@@ -71,6 +71,13 @@ public:
         return glm::perspective(fov, ratio, near, far);
     }
 
+    // pixels one unit spans on screen at distance 1 with the current Zoom, for a viewport `viewportHeight` pixels high;
+    // divide by the distance for anything farther
+    float GetPixelsPerUnit(float viewportHeight) const
+    {
+        return viewportHeight / (2.0f * tan(glm::radians(this->Zoom) * 0.5f));
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboardMovement(Camera_Movement direction, float deltaTime)
     {
@@ -0,0 +1,183 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The subset of the DDS container used for block-compressed textures: BC1, BC3 or BC5 with a full mip chain, rows top
+// first like the images stb_image decodes. Written by tools/texture_convert.cpp, read by the model loader (which prefers
+// <image name>.dds over the image when it is there). Shared by both, so it doesn't depend on OpenGL.
+namespace Dds
+{
+    enum Format { BC1, BC3, BC5 };
+
+    // whether the loader looks for .dds files; off with --no-compressed-textures, or when the driver lacks S3TC
+    inline bool &enabled()
+    {
+        static bool value = true;
+        return value;
+    }
+
+    struct PixelFormat {
+        uint32_t size, flags, fourCC, rgbBitCount, redMask, greenMask, blueMask, alphaMask;
+    };
+
+    struct Header {
+        uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+        uint32_t reserved1[11];
+        PixelFormat pixelFormat;
+        uint32_t caps, caps2, caps3, caps4, reserved2;
+    };
+
+    const uint32_t MAGIC = 0x20534444; // "DDS "
+    const uint32_t HEADER_FLAGS = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+    const uint32_t PIXEL_FORMAT_FOURCC = 0x4;
+    const uint32_t CAPS = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+
+    inline uint32_t fourCC(char a, char b, char c, char d)
+    {
+        return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+    }
+
+    inline uint32_t fourCCOf(Format format)
+    {
+        switch (format)
+        {
+        case BC1: return fourCC('D', 'X', 'T', '1');
+        case BC3: return fourCC('D', 'X', 'T', '5');
+        default:  return fourCC('A', 'T', 'I', '2');
+        }
+    }
+
+    // bytes per 4x4 block
+    inline size_t blockBytes(Format format)
+    {
+        return format == BC1 ? 8 : 16;
+    }
+
+    inline size_t levelSize(Format format, uint32_t width, uint32_t height)
+    {
+        return static_cast<size_t>(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * blockBytes(format);
+    }
+
+    // levels of a full chain, down to 1x1
+    inline uint32_t levelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        while (width > 1 || height > 1)
+        {
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+            levels++;
+        }
+        return levels;
+    }
+
+    // writes the levels, largest first, each levelSize() bytes
+    inline bool write(const string &path, Format format, uint32_t width, uint32_t height, const vector<vector<unsigned char>> &levels)
+    {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        header.size = sizeof(Header);
+        header.flags = HEADER_FLAGS;
+        header.width = width;
+        header.height = height;
+        header.pitchOrLinearSize = static_cast<uint32_t>(levelSize(format, width, height));
+        header.mipMapCount = static_cast<uint32_t>(levels.size());
+        header.pixelFormat.size = sizeof(PixelFormat);
+        header.pixelFormat.flags = PIXEL_FORMAT_FOURCC;
+        header.pixelFormat.fourCC = fourCCOf(format);
+        header.caps = CAPS;
+
+        // written under a temporary name first, so the loader never picks up a half-written file
+        string tmpPath = path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (!file)
+            return false;
+        bool complete = fwrite(&MAGIC, sizeof(MAGIC), 1, file) == 1 && fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const vector<unsigned char> &level : levels)
+            complete = complete && fwrite(level.data(), 1, level.size(), file) == level.size();
+        complete = fclose(file) == 0 && complete;
+        remove(path.c_str());
+        if (!complete || rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    struct Image {
+        Format format;
+        uint32_t width, height, levels;
+        // every level, largest first, in one malloc'd block the caller frees
+        unsigned char *data;
+        size_t size;
+    };
+
+    // reads a file written by write(); false (and nothing to free) for anything else, or a truncated file
+    inline bool read(const string &path, Image &image)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        uint32_t magic = 0;
+        Header header;
+        bool valid = fread(&magic, sizeof(magic), 1, file) == 1 && magic == MAGIC && fread(&header, sizeof(header), 1, file) == 1
+                     && header.size == sizeof(Header) && (header.pixelFormat.flags & PIXEL_FORMAT_FOURCC) && header.width > 0 && header.height > 0;
+        if (valid)
+        {
+            const Format formats[] = { BC1, BC3, BC5 };
+            valid = false;
+            for (Format format : formats)
+                if (header.pixelFormat.fourCC == fourCCOf(format) || (format == BC5 && header.pixelFormat.fourCC == fourCC('B', 'C', '5', 'U')))
+                {
+                    image.format = format;
+                    valid = true;
+                }
+        }
+        if (!valid)
+        {
+            fclose(file);
+            return false;
+        }
+        image.width = header.width;
+        image.height = header.height;
+        image.levels = std::max(1u, std::min(header.mipMapCount, levelCount(header.width, header.height)));
+        image.size = 0;
+        uint32_t width = image.width, height = image.height;
+        for (uint32_t level = 0; level < image.levels; level++)
+        {
+            image.size += levelSize(image.format, width, height);
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+        image.data = static_cast<unsigned char *>(malloc(image.size));
+        bool complete = image.data && fread(image.data, 1, image.size, file) == image.size;
+        fclose(file);
+        if (!complete)
+        {
+            free(image.data);
+            image.data = NULL;
+        }
+        return complete;
+    }
+
+    // where the compressed version of an image file is looked for: the same name with a .dds extension
+    inline string pathFor(const string &imagePath)
+    {
+        size_t dot = imagePath.find_last_of('.');
+        size_t slash = imagePath.find_last_of("/\\");
+        if (dot == string::npos || (slash != string::npos && dot < slash))
+            return imagePath + ".dds";
+        return imagePath.substr(0, dot) + ".dds";
+    }
+}
+#endif
@@ -0,0 +1,592 @@
+#ifndef EVENT_SIMULATION_H
+#define EVENT_SIMULATION_H
+
+#include <physics.h>
+#include <table.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+// Real roots of c[0] + c[1] t + ... + c[degree] t^degree inside [lo, hi], in ascending order; returns their count.
+// The roots of the derivative split the interval into monotonic pieces, each holding at most one root, which is then
+// found by bracketed Newton iteration.
+inline int polynomialRoots(const double *c, int degree, double lo, double hi, double *roots)
+{
+    double scale = 0.0;
+    for (int i = 0; i <= degree; i++)
+        scale = std::max(scale, std::fabs(c[i]));
+    while (degree > 0 && std::fabs(c[degree]) <= 1.0e-12 * scale)
+        degree--;
+    if (degree == 0)
+        return 0;
+    if (degree == 1)
+    {
+        double t = -c[0] / c[1];
+        if (t < lo || t > hi)
+            return 0;
+        roots[0] = t;
+        return 1;
+    }
+
+    double derivative[4];
+    for (int i = 0; i < degree; i++)
+        derivative[i] = (i + 1) * c[i + 1];
+    double bounds[6];
+    bounds[0] = lo;
+    int boundCount = 1 + polynomialRoots(derivative, degree - 1, lo, hi, bounds + 1);
+    bounds[boundCount++] = hi;
+
+    auto evaluate = [&](double t) {
+        double value = c[degree];
+        for (int i = degree - 1; i >= 0; i--)
+            value = value * t + c[i];
+        return value;
+    };
+    auto slope = [&](double t) {
+        double value = derivative[degree - 1];
+        for (int i = degree - 2; i >= 0; i--)
+            value = value * t + derivative[i];
+        return value;
+    };
+
+    int count = 0;
+    for (int s = 0; s + 1 < boundCount; s++)
+    {
+        double a = bounds[s], b = bounds[s + 1];
+        double fa = evaluate(a), fb = evaluate(b);
+        if (fa == 0.0)
+        {
+            if (count == 0 || roots[count - 1] != a)
+                roots[count++] = a;
+            continue;
+        }
+        if ((fa < 0.0) == (fb < 0.0))
+            continue;
+        // keep the bracket [a, b] with f(a) and f(b) of opposite signs, take Newton steps while they stay inside it
+        double t = 0.5 * (a + b);
+        for (int iteration = 0; iteration < 64 && b - a > 1.0e-12 * std::max(1.0, std::fabs(t)); iteration++)
+        {
+            double ft = evaluate(t);
+            if (ft == 0.0)
+                break;
+            if ((ft < 0.0) == (fa < 0.0))
+                a = t, fa = ft;
+            else
+                b = t;
+            double d = slope(t);
+            double next = d != 0.0 ? t - ft / d : a;
+            t = (next > a && next < b) ? next : 0.5 * (a + b);
+        }
+        roots[count++] = t;
+    }
+    return count;
+}
+
+// Event-driven billiard simulation using the same physical model as PhysicsWorld. Between events every ball follows
+// a closed-form trajectory (constant acceleration while sliding or rolling), so the simulator computes when the next
+// ball-ball, ball-cushion, ball-pocket or slide -> roll -> stop transition happens, keeps those times in a priority
+// queue and jumps straight from one event to the next. Every trajectory piece is kept, so the state can be sampled at
+// any time of the shot without stepping.
+class EventSimulation
+{
+public:
+    enum Motion { STATIONARY, SLIDING, ROLLING, POCKETED };
+
+    // one closed-form piece of a ball's trajectory, valid from t0 for at most `duration` seconds
+    struct Segment {
+        double t0, duration;
+        Motion motion;
+        double px, pz, vx, vz, ax, az; // p(t) = p + v t + a t^2 / 2, t relative to t0
+        double ux, uz;                 // slip of the contact point at t0 (sliding only)
+        double wy;                     // spin around the vertical axis at t0
+    };
+
+    // safety net against runaway event chains (balls pressed together bouncing ever faster); past it the current
+    // trajectories simply play out without further events and the shot is flagged as truncated
+    static const size_t MAX_EVENTS = 100000;
+
+    // state of all balls at `time`, refreshed by update()
+    BallSet balls;
+    double time;
+    // first ball the cue ball touched in the current shot, -1 while it hasn't hit anything
+    int firstContact;
+    // number of events processed since the last strike
+    size_t eventCount;
+    // set when simulate() stopped at MAX_EVENTS with events still pending: the rest of the shot ignores collisions,
+    // so balls may pass through cushions and each other and the outcome is not physical
+    bool truncated;
+
+    EventSimulation() : time(0.0), firstContact(-1), eventCount(0), truncated(false)
+    {
+        rack();
+    }
+
+    void rack()
+    {
+        BallSet start;
+        Table::rackPositions(start.px, start.pz);
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            start.vx[i] = start.vz[i] = 0.0f;
+            start.wx[i] = start.wy[i] = start.wz[i] = 0.0f;
+            start.flags[i] = BALL_IN_PLAY;
+        }
+        reset(start);
+    }
+
+    // starts a new shot from the given ball state, at time 0
+    void reset(const BallSet &state)
+    {
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            history[i].clear();
+            Segment segment;
+            segment.t0 = 0.0;
+            segment.px = state.px[i];
+            segment.pz = state.pz[i];
+            segment.vx = state.vx[i];
+            segment.vz = state.vz[i];
+            segment.ux = state.vx[i] + Table::BALL_RADIUS * state.wz[i];
+            segment.uz = state.vz[i] - Table::BALL_RADIUS * state.wx[i];
+            segment.wy = state.wy[i];
+            segment.motion = (state.flags[i] & BALL_IN_PLAY) ? SLIDING : POCKETED;
+            history[i].push_back(classify(segment));
+        }
+        time = 0.0;
+        firstContact = -1;
+        eventCount = 0;
+        truncated = false;
+        sample(0.0, balls);
+        scheduled = false;
+    }
+
+    // hits a ball with the same parameters as PhysicsWorld::strike and resolves the whole shot right away
+    void strike(int ball, float angle, float speed, float follow = 0.0f, float side = 0.0f)
+    {
+        BallSet state;
+        sample(time, state);
+        const float R = Table::BALL_RADIUS;
+        float dx = std::cos(angle), dz = std::sin(angle);
+        state.vx[ball] = dx * speed;
+        state.vz[ball] = dz * speed;
+        state.wx[ball] = follow * dz * speed / R;
+        state.wz[ball] = -follow * dx * speed / R;
+        state.wy[ball] = side * speed / R;
+        reset(state);
+        simulate();
+    }
+
+    // processes events in time order until every ball is at rest (or pocketed) or the next event lies after `until`
+    void simulate(double until = std::numeric_limits<double>::infinity())
+    {
+        if (!scheduled)
+        {
+            while (!events.empty())
+                events.pop();
+            for (int i = 0; i < Table::BALL_COUNT; i++)
+                version[i] = 0;
+            for (int i = 0; i < Table::BALL_COUNT; i++)
+                scheduleBall(i, i + 1);
+            scheduled = true;
+        }
+        while (!events.empty() && events.top().time <= until && eventCount < MAX_EVENTS)
+        {
+            Event event = events.top();
+            events.pop();
+            if (version[event.a] != event.versionA || (event.b >= 0 && version[event.b] != event.versionB))
+                continue; // a trajectory involved changed after this event was predicted
+            process(event);
+        }
+        truncated = eventCount >= MAX_EVENTS && !events.empty();
+    }
+
+    // time at which the last ball came to rest, once simulate() ran to completion
+    double restTime() const
+    {
+        double end = 0.0;
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+            end = std::max(end, history[i].back().t0);
+        return end;
+    }
+
+    // advances the playback clock and samples every ball at the new time
+    void update(float frameSeconds)
+    {
+        time += frameSeconds;
+        sample(time, balls);
+    }
+
+    bool moving() const
+    {
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+            if (balls.flags[i] & (BALL_SLIDING | BALL_ROLLING))
+                return true;
+        return false;
+    }
+
+    // state of every ball at time t (seconds since the strike)
+    void sample(double t, BallSet &out) const
+    {
+        const double R = Table::BALL_RADIUS;
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            const Segment &s = segmentAt(i, t);
+            double tau = std::min(std::max(t - s.t0, 0.0), s.duration);
+            double vx = s.vx + s.ax * tau, vz = s.vz + s.az * tau;
+            out.px[i] = static_cast<float>(s.px + (s.vx + 0.5 * s.ax * tau) * tau);
+            out.pz[i] = static_cast<float>(s.pz + (s.vz + 0.5 * s.az * tau) * tau);
+            out.vx[i] = static_cast<float>(vx);
+            out.vz[i] = static_cast<float>(vz);
+            if (s.motion == SLIDING)
+            {
+                // the slip shrinks along its own direction at 7/2 mu_s g; spin follows from velocity and slip
+                double u = std::sqrt(s.ux * s.ux + s.uz * s.uz);
+                double k = u > 0.0 ? std::max(0.0, 1.0 - 3.5 * Table::SLIDING_FRICTION * Table::GRAVITY * tau / u) : 0.0;
+                out.wx[i] = static_cast<float>((vz - s.uz * k) / R);
+                out.wz[i] = static_cast<float>((s.ux * k - vx) / R);
+            }
+            else
+            {
+                out.wx[i] = static_cast<float>(vz / R);
+                out.wz[i] = static_cast<float>(-vx / R);
+            }
+            double spinDecay = 2.5 * Table::SPINNING_FRICTION * Table::GRAVITY / R * std::max(t - s.t0, 0.0);
+            out.wy[i] = static_cast<float>(std::fabs(s.wy) > spinDecay ? s.wy - std::copysign(spinDecay, s.wy) : 0.0);
+            out.flags[i] = s.motion == POCKETED ? BALL_POCKETED
+                         : BALL_IN_PLAY | (s.motion == SLIDING ? BALL_SLIDING : s.motion == ROLLING ? BALL_ROLLING : 0u);
+        }
+    }
+
+private:
+    enum EventType { TRANSITION, BALL_BALL, CUSHION_X, CUSHION_Z, POCKET };
+
+    struct Event {
+        double time;
+        EventType type;
+        int a, b;                       // balls involved (b = -1 unless BALL_BALL)
+        uint32_t versionA, versionB;
+        bool operator>(const Event &other) const { return time > other.time; }
+    };
+
+    std::vector<Segment> history[Table::BALL_COUNT];
+    uint32_t version[Table::BALL_COUNT];
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    bool scheduled;
+
+    const Segment &segmentAt(int ball, double t) const
+    {
+        const std::vector<Segment> &segments = history[ball];
+        std::vector<Segment>::const_iterator it = std::upper_bound(segments.begin(), segments.end(), t,
+            [](double value, const Segment &segment) { return value < segment.t0; });
+        return it == segments.begin() ? segments.front() : *(it - 1);
+    }
+
+    // fills in motion, acceleration and duration of a segment from its velocity and slip
+    static Segment classify(Segment s)
+    {
+        const double g = Table::GRAVITY;
+        double rest = PhysicsWorld::REST_SPEED;
+        s.ax = s.az = 0.0;
+        if (s.motion == POCKETED)
+        {
+            s.vx = s.vz = s.ux = s.uz = s.wy = 0.0;
+            s.duration = std::numeric_limits<double>::infinity();
+            return s;
+        }
+        double u = std::sqrt(s.ux * s.ux + s.uz * s.uz);
+        double v = std::sqrt(s.vx * s.vx + s.vz * s.vz);
+        if (u > rest)
+        {
+            s.motion = SLIDING;
+            s.ax = -Table::SLIDING_FRICTION * g * s.ux / u;
+            s.az = -Table::SLIDING_FRICTION * g * s.uz / u;
+            s.duration = u / (3.5 * Table::SLIDING_FRICTION * g);
+        }
+        else if (v > rest)
+        {
+            s.motion = ROLLING;
+            s.ux = s.uz = 0.0;
+            s.ax = -Table::ROLLING_FRICTION * g * s.vx / v;
+            s.az = -Table::ROLLING_FRICTION * g * s.vz / v;
+            s.duration = v / (Table::ROLLING_FRICTION * g);
+        }
+        else
+        {
+            s.motion = STATIONARY;
+            s.vx = s.vz = s.ux = s.uz = 0.0;
+            s.duration = std::numeric_limits<double>::infinity();
+        }
+        return s;
+    }
+
+    // the ball's state at time t as the start of a new segment (motion still to be classified)
+    Segment stateAt(int ball, double t) const
+    {
+        const Segment &s = segmentAt(ball, t);
+        double tau = std::min(std::max(t - s.t0, 0.0), s.duration);
+        Segment next = s;
+        next.t0 = t;
+        next.px = s.px + (s.vx + 0.5 * s.ax * tau) * tau;
+        next.pz = s.pz + (s.vz + 0.5 * s.az * tau) * tau;
+        next.vx = s.vx + s.ax * tau;
+        next.vz = s.vz + s.az * tau;
+        if (s.motion == SLIDING)
+        {
+            double u = std::sqrt(s.ux * s.ux + s.uz * s.uz);
+            double k = u > 0.0 ? std::max(0.0, 1.0 - 3.5 * Table::SLIDING_FRICTION * Table::GRAVITY * tau / u) : 0.0;
+            next.ux = s.ux * k;
+            next.uz = s.uz * k;
+        }
+        else
+            next.ux = next.uz = 0.0;
+        double spinDecay = 2.5 * Table::SPINNING_FRICTION * Table::GRAVITY / Table::BALL_RADIUS * tau;
+        next.wy = std::fabs(s.wy) > spinDecay ? s.wy - std::copysign(spinDecay, s.wy) : 0.0;
+        return next;
+    }
+
+    // starts a new trajectory piece for a ball and invalidates every event predicted from its old one
+    void beginSegment(int ball, Segment segment)
+    {
+        Segment classified = classify(segment);
+        if (history[ball].back().t0 == classified.t0)
+            history[ball].back() = classified;
+        else
+            history[ball].push_back(classified);
+        version[ball]++;
+    }
+
+    void push(double t, EventType type, int a, int b)
+    {
+        Event event;
+        event.time = t;
+        event.type = type;
+        event.a = a;
+        event.b = b;
+        event.versionA = version[a];
+        event.versionB = b >= 0 ? version[b] : 0;
+        events.push(event);
+    }
+
+    // predicts the next events of a ball whose trajectory just changed, pair events with every other ball numbered
+    // firstPartner or above (a pair predicted twice is harmless: the second copy is stale once the first is processed)
+    void scheduleBall(int i, int firstPartner)
+    {
+        const Segment &s = history[i].back();
+        if (s.motion == POCKETED)
+            return;
+        double t = s.t0;
+        bool moving = s.motion != STATIONARY;
+        if (moving)
+        {
+            push(t + s.duration, TRANSITION, i, -1);
+            scheduleCushions(i, s);
+            schedulePockets(i, s);
+        }
+        for (int j = firstPartner; j < Table::BALL_COUNT; j++)
+            if (j != i)
+                schedulePair(i, j, t);
+    }
+
+    void scheduleCushions(int i, const Segment &s)
+    {
+        const double xMax = Table::LENGTH * 0.5 - Table::BALL_RADIUS;
+        const double zMax = Table::WIDTH * 0.5 - Table::BALL_RADIUS;
+        double best = std::numeric_limits<double>::infinity();
+        EventType type = CUSHION_X;
+        for (int axis = 0; axis < 2; axis++)
+        {
+            double p = axis == 0 ? s.px : s.pz, v = axis == 0 ? s.vx : s.vz, a = axis == 0 ? s.ax : s.az;
+            double limit = axis == 0 ? xMax : zMax;
+            for (int side = -1; side <= 1; side += 2)
+            {
+                double c[3] = { p - side * limit, v, 0.5 * a };
+                double roots[2];
+                int count = polynomialRoots(c, 2, 0.0, s.duration, roots);
+                for (int r = 0; r < count; r++)
+                {
+                    double tau = roots[r];
+                    if ((v + a * tau) * side <= 0.0 || tau >= best)
+                        continue; // not moving into this cushion
+                    double x = s.px + (s.vx + 0.5 * s.ax * tau) * tau, z = s.pz + (s.vz + 0.5 * s.az * tau) * tau;
+                    if (inOpening(x, z, axis))
+                        continue;
+                    best = tau;
+                    type = axis == 0 ? CUSHION_X : CUSHION_Z;
+                    break;
+                }
+            }
+        }
+        if (best < std::numeric_limits<double>::infinity())
+            push(s.t0 + best, type, i, -1);
+    }
+
+    // whether the cushion along `axis` (0 = the short rails at +-x, 1 = the long rails at +-z) is open at (x, z)
+    static bool inOpening(double x, double z, int axis)
+    {
+        bool cornerMouth = std::fabs(x) > Table::LENGTH * 0.5 - Table::CORNER_MOUTH
+                           && std::fabs(z) > Table::WIDTH * 0.5 - Table::CORNER_MOUTH;
+        bool sideMouth = axis == 1 && std::fabs(x) < Table::SIDE_MOUTH;
+        return cornerMouth || sideMouth;
+    }
+
+    // earliest time the ball enters a pocket circle or leaves the bed through an opening
+    void schedulePockets(int i, const Segment &s)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        double reach = std::sqrt(s.vx * s.vx + s.vz * s.vz) * std::min(s.duration, 1.0e3);
+        for (int p = 0; p < Table::POCKET_COUNT; p++)
+        {
+            double cx = s.px - Table::POCKET_X[p], cz = s.pz - Table::POCKET_Z[p];
+            double r = Table::POCKET_RADIUS[p];
+            if (std::sqrt(cx * cx + cz * cz) - r > reach)
+                continue;
+            if (cx * cx + cz * cz <= r * r)
+            {
+                best = 0.0;
+                break;
+            }
+            double tau = firstApproach(cx, cz, s.vx, s.vz, 0.5 * s.ax, 0.5 * s.az, r, s.duration);
+            best = std::min(best, tau);
+        }
+        // leaving the bed: only possible through an opening, since the cushions bounce the ball everywhere else
+        const double xOut = Table::LENGTH * 0.5 + Table::BALL_RADIUS, zOut = Table::WIDTH * 0.5 + Table::BALL_RADIUS;
+        for (int axis = 0; axis < 2; axis++)
+        {
+            double p = axis == 0 ? s.px : s.pz, v = axis == 0 ? s.vx : s.vz, a = axis == 0 ? s.ax : s.az;
+            for (int side = -1; side <= 1; side += 2)
+            {
+                double c[3] = { p - side * (axis == 0 ? xOut : zOut), v, 0.5 * a };
+                double roots[2];
+                int count = polynomialRoots(c, 2, 0.0, s.duration, roots);
+                for (int r = 0; r < count; r++)
+                    if ((v + a * roots[r]) * side > 0.0)
+                    {
+                        best = std::min(best, roots[r]);
+                        break;
+                    }
+            }
+        }
+        if (best < std::numeric_limits<double>::infinity())
+            push(s.t0 + best, POCKET, i, -1);
+    }
+
+    // first tau in [0, horizon] at which |c + b tau + a tau^2| shrinks to `distance` (0 if already inside and closing)
+    static double firstApproach(double cx, double cz, double bx, double bz, double ax, double az, double distance, double horizon)
+    {
+        double coefficients[5] = {
+            cx * cx + cz * cz - distance * distance,
+            2.0 * (bx * cx + bz * cz),
+            bx * bx + bz * bz + 2.0 * (ax * cx + az * cz),
+            2.0 * (ax * bx + az * bz),
+            ax * ax + az * az
+        };
+        // already in contact: collide now if closing in, with some margin so that a graze at zero normal speed (which
+        // rounding can make look like closing) doesn't bounce forever at the same instant
+        if (coefficients[0] <= 0.0)
+            return coefficients[1] < -1.0e-12 ? 0.0 : std::numeric_limits<double>::infinity();
+        double roots[4];
+        int count = polynomialRoots(coefficients, 4, 0.0, horizon, roots);
+        for (int r = 0; r < count; r++)
+        {
+            double tau = roots[r];
+            // derivative of the squared distance; a real contact has the balls closing in
+            double closing = coefficients[1] + tau * (2.0 * coefficients[2] + tau * (3.0 * coefficients[3] + tau * 4.0 * coefficients[4]));
+            if (closing < 0.0)
+                return tau;
+        }
+        return std::numeric_limits<double>::infinity();
+    }
+
+    void schedulePair(int i, int j, double t)
+    {
+        Segment a = stateAt(i, t), b = stateAt(j, t);
+        const Segment &sa = history[i].back(), &sb = history[j].back();
+        if (sb.motion == POCKETED || (sa.motion == STATIONARY && sb.motion == STATIONARY))
+            return;
+        // both trajectories are only valid until their next transition, which triggers a new prediction anyway
+        double horizon = std::min(sa.t0 + sa.duration, sb.t0 + sb.duration) - t;
+        if (horizon <= 0.0)
+            return;
+        double cx = b.px - a.px, cz = b.pz - a.pz;
+        double bx = b.vx - a.vx, bz = b.vz - a.vz;
+        double ax = 0.5 * (sb.ax - sa.ax), az = 0.5 * (sb.az - sa.az);
+        // cheap reject: can't close the gap within the horizon even at the current relative speed plus acceleration
+        double gap = std::sqrt(cx * cx + cz * cz) - 2.0 * Table::BALL_RADIUS;
+        double h = std::min(horizon, 1.0e3);
+        if (gap > std::sqrt(bx * bx + bz * bz) * h + std::sqrt(ax * ax + az * az) * h * h)
+            return;
+        double tau = firstApproach(cx, cz, bx, bz, ax, az, 2.0 * Table::BALL_RADIUS, horizon);
+        if (tau < std::numeric_limits<double>::infinity())
+            push(t + tau, BALL_BALL, i, j);
+    }
+
+    void process(const Event &event)
+    {
+        double t = event.time;
+        eventCount++;
+        Segment a = stateAt(event.a, t);
+        switch (event.type)
+        {
+        case TRANSITION:
+            // sliding turns into rolling (slip is zero now), rolling into rest
+            if (a.motion == SLIDING)
+                a.ux = a.uz = 0.0;
+            else
+                a.vx = a.vz = 0.0;
+            beginSegment(event.a, a);
+            break;
+        case CUSHION_X:
+        case CUSHION_Z:
+        {
+            double &v = event.type == CUSHION_X ? a.vx : a.vz;
+            double &u = event.type == CUSHION_X ? a.ux : a.uz;
+            double before = v;
+            v = -Table::CUSHION_RESTITUTION * v;
+            u += v - before; // spin is unchanged, so the slip changes with the velocity
+            beginSegment(event.a, a);
+            break;
+        }
+        case POCKET:
+            a.motion = POCKETED;
+            beginSegment(event.a, a);
+            break;
+        case BALL_BALL:
+        {
+            Segment b = stateAt(event.b, t);
+            double nx = b.px - a.px, nz = b.pz - a.pz;
+            double d = std::sqrt(nx * nx + nz * nz);
+            nx /= d;
+            nz /= d;
+            double approach = (a.vx - b.vx) * nx + (a.vz - b.vz) * nz;
+            if (approach > 0.0)
+            {
+                double impulse = 0.5 * (1.0 + Table::BALL_RESTITUTION) * approach;
+                a.vx -= impulse * nx;
+                a.vz -= impulse * nz;
+                a.ux -= impulse * nx;
+                a.uz -= impulse * nz;
+                b.vx += impulse * nx;
+                b.vz += impulse * nz;
+                b.ux += impulse * nx;
+                b.uz += impulse * nz;
+                if (event.a == 0 && firstContact < 0)
+                    firstContact = event.b;
+                else if (event.b == 0 && firstContact < 0)
+                    firstContact = event.a;
+            }
+            beginSegment(event.a, a);
+            beginSegment(event.b, b);
+            scheduleBall(event.a, 0);
+            scheduleBall(event.b, 0);
+            return;
+        }
+        }
+        scheduleBall(event.a, 0);
+    }
+};
+#endif
@@ -0,0 +1,188 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Axis-aligned box as center and half extents
+struct Aabb {
+    glm::vec3 center, extents;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// bounds of a set of points `stride` bytes apart: the box around them and the sphere around the box center reaching
+// the farthest one
+inline void computeBounds(const glm::vec3 *first, size_t count, size_t stride, Aabb &box, BoundingSphere &sphere)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(first);
+    auto point = [&](size_t i) -> const glm::vec3 & { return *reinterpret_cast<const glm::vec3 *>(bytes + i * stride); };
+    glm::vec3 low(0.0f), high(0.0f);
+    if (count > 0)
+        low = high = point(0);
+    for (size_t i = 1; i < count; i++)
+    {
+        low = glm::min(low, point(i));
+        high = glm::max(high, point(i));
+    }
+    box.center = (low + high) * 0.5f;
+    box.extents = (high - low) * 0.5f;
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 d = point(i) - box.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    sphere.center = box.center;
+    sphere.radius = std::sqrt(radius2);
+}
+
+// the box around a transformed box: the center is transformed, the extents projected on the new axes
+inline Aabb transformBounds(const Aabb &box, const glm::mat4 &transform)
+{
+    Aabb result;
+    result.center = glm::vec3(transform * glm::vec4(box.center, 1.0f));
+    glm::mat3 axes(transform);
+    for (int row = 0; row < 3; row++)
+        result.extents[row] = std::fabs(axes[0][row]) * box.extents.x + std::fabs(axes[1][row]) * box.extents.y +
+                              std::fabs(axes[2][row]) * box.extents.z;
+    return result;
+}
+
+// the sphere scaled by the largest axis scale of the transform
+inline BoundingSphere transformBounds(const BoundingSphere &sphere, const glm::mat4 &transform)
+{
+    BoundingSphere result;
+    result.center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    result.radius = sphere.radius * scale;
+    return result;
+}
+
+// World-space bounds of many objects in structure-of-arrays form, padded to a multiple of 4 so Frustum::cull can test
+// four at a time
+struct CullSet {
+    vector<float> cx, cy, cz, ex, ey, ez; // boxes
+    vector<float> sx, sy, sz, sr;         // spheres
+    size_t count;
+
+    CullSet() : count(0) {}
+
+    void add(const Aabb &box, const BoundingSphere &sphere)
+    {
+        // the padding lanes are a degenerate box at the origin: never read back
+        size_t padded = (count + 4) & ~static_cast<size_t>(3);
+        for (vector<float> *lane : { &cx, &cy, &cz, &ex, &ey, &ez, &sx, &sy, &sz, &sr })
+            lane->resize(padded, 0.0f);
+        cx[count] = box.center.x;  cy[count] = box.center.y;  cz[count] = box.center.z;
+        ex[count] = box.extents.x; ey[count] = box.extents.y; ez[count] = box.extents.z;
+        sx[count] = sphere.center.x; sy[count] = sphere.center.y; sz[count] = sphere.center.z;
+        sr[count] = sphere.radius;
+        count++;
+    }
+};
+
+// The six planes of a view frustum, pointing inwards, extracted from a projection * view matrix (Gribb/Hartmann)
+class Frustum
+{
+public:
+    // planes as (normal, distance) with unit normals: a point p is inside a plane when dot(normal, p) + distance >= 0
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        planes[0] = row[3] + row[0]; // left
+        planes[1] = row[3] - row[0]; // right
+        planes[2] = row[3] + row[1]; // bottom
+        planes[3] = row[3] - row[1]; // top
+        planes[4] = row[3] + row[2]; // near
+        planes[5] = row[3] - row[2]; // far
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    // whether a single box may be visible
+    bool visible(const Aabb &box) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 normal(plane);
+            float reach = glm::dot(glm::abs(normal), box.extents);
+            if (glm::dot(normal, box.center) + plane.w + reach < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    bool visible(const BoundingSphere &sphere) const
+    {
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w + sphere.radius < 0.0f)
+                return false;
+        return true;
+    }
+
+    // sets visible[i] to 1 for every object of the set whose sphere and box both reach inside all planes, else 0;
+    // returns how many are visible
+    size_t cull(const CullSet &set, vector<uint8_t> &visible) const
+    {
+        visible.resize(set.count);
+        size_t count = 0;
+#ifdef __SSE2__
+        for (size_t i = 0; i < set.count; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(&set.cx[i]), cy = _mm_loadu_ps(&set.cy[i]), cz = _mm_loadu_ps(&set.cz[i]);
+            __m128 ex = _mm_loadu_ps(&set.ex[i]), ey = _mm_loadu_ps(&set.ey[i]), ez = _mm_loadu_ps(&set.ez[i]);
+            __m128 sx = _mm_loadu_ps(&set.sx[i]), sy = _mm_loadu_ps(&set.sy[i]), sz = _mm_loadu_ps(&set.sz[i]);
+            __m128 sr = _mm_loadu_ps(&set.sr[i]);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4 &plane : planes)
+            {
+                __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+                __m128 ax = _mm_set1_ps(std::fabs(plane.x)), ay = _mm_set1_ps(std::fabs(plane.y)), az = _mm_set1_ps(std::fabs(plane.z));
+                // box: signed distance of the center plus the extents projected on the normal
+                __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), d));
+                __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ex), _mm_mul_ps(ay, ey)), _mm_mul_ps(az, ez));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(boxDistance, reach), _mm_setzero_ps()));
+                // sphere: signed distance of the center plus the radius
+                __m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)), _mm_add_ps(_mm_mul_ps(nz, sz), d));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(sphereDistance, sr), _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (size_t lane = 0; lane < 4 && i + lane < set.count; lane++)
+            {
+                visible[i + lane] = (mask >> lane) & 1;
+                count += visible[i + lane];
+            }
+        }
+#else
+        for (size_t i = 0; i < set.count; i++)
+        {
+            Aabb box = { glm::vec3(set.cx[i], set.cy[i], set.cz[i]), glm::vec3(set.ex[i], set.ey[i], set.ez[i]) };
+            BoundingSphere sphere = { glm::vec3(set.sx[i], set.sy[i], set.sz[i]), set.sr[i] };
+            visible[i] = this->visible(sphere) && this->visible(box);
+            count += visible[i];
+        }
+#endif
+        return count;
+    }
+};
+#endif
@@ -0,0 +1,341 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "instance_buffer.h"
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+// One vertex buffer, one index buffer and one VAO shared by every mesh of a vertex layout. A mesh is a range of
+// vertices and a range of indices in them, drawn with glDrawElementsBaseVertex (its indices stay relative to its first
+// vertex), so consecutive meshes of the same layout draw without switching VAOs. Both buffers are managed as free lists:
+// released ranges are reused first-fit and merged with their free neighbours, and the buffers double when nothing fits.
+// Buffers are never freed explicitly; they go with the context at glfwTerminate.
+class GeometryArena
+{
+public:
+    // where a mesh lives in the arena
+    struct Range {
+        GLint baseVertex;
+        GLsizei vertexCount;
+        size_t firstIndex;
+        GLsizei indexCount;
+    };
+
+    // sizes in bytes; fragmentation is the share of free space outside the largest free block (0 = all in one piece)
+    struct Stats {
+        size_t vertexCapacity, vertexUsed, vertexFreeBlocks, vertexLargestFree;
+        size_t indexCapacity, indexUsed, indexFreeBlocks, indexLargestFree;
+        size_t ranges;
+        float vertexFragmentation, indexFragmentation;
+    };
+
+    VertexLayout layout;
+
+    // arena of a vertex layout, created on first use (needs a current context)
+    static GeometryArena &forLayout(VertexLayout layout)
+    {
+        static GeometryArena *arenas[2] = { NULL, NULL };
+        if (!arenas[layout])
+            arenas[layout] = new GeometryArena(layout);
+        return *arenas[layout];
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // copies vertices (in the arena's layout, vertexCount * stride() bytes) and mesh-relative indices into the arena; with
+    // a null indexData the indices are only reserved, to be filled piece by piece with writeIndices
+    Range allocate(const void *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
+    {
+        Range range;
+        size_t firstVertex = vertexSpace.allocate(vertexCount);
+        range.firstIndex = indexSpace.allocate(indexCount);
+        range.baseVertex = static_cast<GLint>(firstVertex);
+        range.vertexCount = static_cast<GLsizei>(vertexCount);
+        range.indexCount = static_cast<GLsizei>(indexCount);
+        reserve();
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * stride(), vertexCount * stride(), vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (indexData)
+            writeIndices(range.firstIndex, indexData, indexCount);
+        ranges++;
+        return range;
+    }
+
+    // copies mesh-relative indices to `firstIndex`, inside a range allocate() reserved
+    void writeIndices(size_t firstIndex, const unsigned int *indexData, size_t indexCount)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint), indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // returns a range to the free lists; its contents are simply overwritten by a later allocation
+    void release(const Range &range)
+    {
+        vertexSpace.release(static_cast<size_t>(range.baseVertex), static_cast<size_t>(range.vertexCount));
+        indexSpace.release(range.firstIndex, static_cast<size_t>(range.indexCount));
+        ranges--;
+    }
+
+    // binds the arena's VAO; it is left bound after drawing, other code binds its own VAO before using one
+    void bind() const
+    {
+        GLState::current().bindVertexArray(VAO);
+    }
+
+    // for sort keys
+    GLuint vertexArray() const
+    {
+        return VAO;
+    }
+
+    // draws a range with the arena bound
+    void draw(const Range &range) const
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                 (void*)(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+    }
+
+    // draws one copy of a range per instance, with the arena bound
+    void drawInstanced(const Range &range, const InstanceBuffer &instances)
+    {
+        // the instance attributes are part of the VAO state, so they only need pointing at a buffer once
+        if (attachedInstances != instances.ID)
+        {
+            instances.attach();
+            attachedInstances = instances.ID;
+        }
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                          (void*)(range.firstIndex * sizeof(GLuint)), instances.count, range.baseVertex);
+    }
+
+    // disables the instance attributes, with the arena bound, for draws whose instances index something else (a
+    // multi-draw's baseInstance could run past the end of the instance buffer)
+    void detachInstances()
+    {
+        if (attachedInstances == 0)
+            return;
+        InstanceBuffer::detach();
+        attachedInstances = 0;
+    }
+
+    size_t stride() const
+    {
+        return layout == VERTEX_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    }
+
+    Stats stats() const
+    {
+        Stats stats;
+        stats.vertexCapacity = vertexSpace.capacity * stride();
+        stats.vertexUsed = vertexSpace.used * stride();
+        stats.vertexFreeBlocks = vertexSpace.freeBlocks();
+        stats.vertexLargestFree = vertexSpace.largestFree() * stride();
+        stats.vertexFragmentation = vertexSpace.fragmentation();
+        stats.indexCapacity = indexSpace.capacity * sizeof(GLuint);
+        stats.indexUsed = indexSpace.used * sizeof(GLuint);
+        stats.indexFreeBlocks = indexSpace.freeBlocks();
+        stats.indexLargestFree = indexSpace.largestFree() * sizeof(GLuint);
+        stats.indexFragmentation = indexSpace.fragmentation();
+        stats.ranges = ranges;
+        return stats;
+    }
+
+private:
+    // initial sizes, in vertices and indices; enough for the scene's meshes without growing
+    static const size_t INITIAL_VERTICES = 1 << 16;
+    static const size_t INITIAL_INDICES = 1 << 18;
+
+    // first-fit allocator over [0, capacity) in elements; capacity only grows, `end` is the high-water mark
+    struct Space {
+        map<size_t, size_t> freeRanges; // offset -> size, below `end`
+        size_t end, capacity, used;
+
+        explicit Space(size_t capacity) : end(0), capacity(capacity), used(0) {}
+
+        size_t allocate(size_t count)
+        {
+            used += count;
+            for (map<size_t, size_t>::iterator it = freeRanges.begin(); it != freeRanges.end(); ++it)
+                if (it->second >= count)
+                {
+                    size_t offset = it->first, remaining = it->second - count;
+                    freeRanges.erase(it);
+                    if (remaining > 0)
+                        freeRanges[offset + count] = remaining;
+                    return offset;
+                }
+            size_t offset = end;
+            end += count;
+            return offset;
+        }
+
+        void release(size_t offset, size_t count)
+        {
+            if (count == 0)
+                return;
+            used -= count;
+            map<size_t, size_t>::iterator next = freeRanges.lower_bound(offset);
+            if (next != freeRanges.end() && offset + count == next->first)
+            {
+                count += next->second;
+                next = freeRanges.erase(next);
+            }
+            if (next != freeRanges.begin())
+            {
+                map<size_t, size_t>::iterator previous = std::prev(next);
+                if (previous->first + previous->second == offset)
+                {
+                    offset = previous->first;
+                    count += previous->second;
+                    freeRanges.erase(previous);
+                }
+            }
+            // a free range touching the high-water mark just lowers it
+            if (offset + count == end)
+                end = offset;
+            else
+                freeRanges[offset] = count;
+        }
+
+        // free ranges below the high-water mark, plus the unused tail of the buffer
+        size_t freeBlocks() const
+        {
+            return freeRanges.size() + (end < capacity ? 1 : 0);
+        }
+
+        size_t largestFree() const
+        {
+            size_t largest = capacity - end;
+            for (map<size_t, size_t>::const_iterator it = freeRanges.begin(); it != freeRanges.end(); ++it)
+                largest = std::max(largest, it->second);
+            return largest;
+        }
+
+        float fragmentation() const
+        {
+            size_t free = capacity - used;
+            return free > 0 ? 1.0f - static_cast<float>(largestFree()) / static_cast<float>(free) : 0.0f;
+        }
+    };
+
+    GLuint VAO, VBO, EBO;
+    Space vertexSpace, indexSpace;
+    size_t ranges;
+    // instance buffer the VAO's instance attributes point at, 0 if none
+    GLuint attachedInstances;
+
+    explicit GeometryArena(VertexLayout layout)
+        : layout(layout), vertexSpace(INITIAL_VERTICES), indexSpace(INITIAL_INDICES), ranges(0), attachedInstances(0)
+    {
+        glGenVertexArrays(1, &VAO);
+        VBO = createBuffer(vertexSpace.capacity * stride());
+        EBO = createBuffer(indexSpace.capacity * sizeof(GLuint));
+        setupAttributes();
+    }
+
+    static GLuint createBuffer(size_t bytes)
+    {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // moves a buffer's first `used` bytes into a new buffer of `bytes` bytes
+    static GLuint growBuffer(GLuint buffer, size_t used, size_t bytes)
+    {
+        GLuint grown = createBuffer(bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        return grown;
+    }
+
+    // grows the buffers (at least doubling them) once the high-water marks pass their capacity
+    void reserve()
+    {
+        bool grown = false;
+        if (vertexSpace.end > vertexSpace.capacity)
+        {
+            size_t capacity = std::max(vertexSpace.capacity * 2, vertexSpace.end);
+            VBO = growBuffer(VBO, vertexSpace.capacity * stride(), capacity * stride());
+            vertexSpace.capacity = capacity;
+            grown = true;
+        }
+        if (indexSpace.end > indexSpace.capacity)
+        {
+            size_t capacity = std::max(indexSpace.capacity * 2, indexSpace.end);
+            EBO = growBuffer(EBO, indexSpace.capacity * sizeof(GLuint), capacity * sizeof(GLuint));
+            indexSpace.capacity = capacity;
+            grown = true;
+        }
+        if (grown)
+            setupAttributes();
+    }
+
+    // points the VAO at the current buffers
+    void setupAttributes()
+    {
+        GLState::current().bindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (layout == VERTEX_COMPACT)
+        {
+            // packed position (w = bitangent sign), octahedral normal, texture coords and octahedral tangent, all
+            // normalized integers decoded in the vertex shader (models/common/vertexFormat.glsl)
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, texCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, tangent));
+        }
+        else
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+            // bone ids and weights, only read by skinning shaders
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        }
+        GLState::current().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
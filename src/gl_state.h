@@ -0,0 +1,146 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Shadow copy of the bound program, vertex array, active texture unit and per-unit texture bindings. Binds that
+// wouldn't change anything are skipped, and every bind is counted as issued or skipped so the render loop can report
+// them per frame. Code binding any of these must go through current() for the copy to stay right; objects deleted while
+// they may be bound must be passed to forget*().
+class GLState
+{
+public:
+    static const GLuint TEXTURE_UNITS = 16;
+
+    struct Count {
+        size_t issued, skipped;
+    };
+
+    struct Counters {
+        Count programs, vertexArrays, textures;
+    };
+
+    // the state of the context, which lives on the main thread
+    static GLState &current()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (program == boundProgram)
+        {
+            counters.programs.skipped++;
+            return;
+        }
+        glUseProgram(program);
+        boundProgram = program;
+        counters.programs.issued++;
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (vertexArray == boundVertexArray)
+        {
+            counters.vertexArrays.skipped++;
+            return;
+        }
+        glBindVertexArray(vertexArray);
+        boundVertexArray = vertexArray;
+        counters.vertexArrays.issued++;
+    }
+
+    // binds a texture to a unit and leaves that unit active, so glTexParameter and friends can follow
+    void bindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        activeTexture(unit);
+        int index = targetIndex(target);
+        if (unit < TEXTURE_UNITS && index >= 0 && textures[unit][index] == texture)
+        {
+            counters.textures.skipped++;
+            return;
+        }
+        glBindTexture(target, texture);
+        if (unit < TEXTURE_UNITS && index >= 0)
+            textures[unit][index] = texture;
+        counters.textures.issued++;
+    }
+
+    void activeTexture(GLuint unit)
+    {
+        if (unit == activeUnit)
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+
+    // a deleted object's name can come back for a new one, so its binding must not be trusted any more
+    void forgetProgram(GLuint program)
+    {
+        if (program == boundProgram)
+            boundProgram = UNKNOWN;
+    }
+    void forgetVertexArray(GLuint vertexArray)
+    {
+        if (vertexArray == boundVertexArray)
+            boundVertexArray = UNKNOWN;
+    }
+    void forgetTexture(GLuint texture)
+    {
+        for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (int index = 0; index < TEXTURE_TARGETS; index++)
+                if (textures[unit][index] == texture)
+                    textures[unit][index] = UNKNOWN;
+    }
+
+    // for state changed behind the cache's back: the next bind of every kind is issued
+    void invalidate()
+    {
+        boundProgram = boundVertexArray = activeUnit = UNKNOWN;
+        for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (int index = 0; index < TEXTURE_TARGETS; index++)
+                textures[unit][index] = UNKNOWN;
+    }
+
+    // counts since the last call
+    Counters takeCounters()
+    {
+        Counters taken = counters;
+        counters = Counters();
+        return taken;
+    }
+
+private:
+    // texture targets whose bindings are tracked (each unit has a binding per target); others are always bound
+    static const int TEXTURE_TARGETS = 3;
+
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:       return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_BUFFER:   return 2;
+        default:                  return -1;
+        }
+    }
+
+    // never a valid name, so nothing compares equal to it
+    static const GLuint UNKNOWN = ~0u;
+
+    GLuint boundProgram, boundVertexArray, activeUnit;
+    GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    Counters counters;
+
+    // a fresh context has everything unbound and unit 0 active
+    GLState() : boundProgram(0), boundVertexArray(0), activeUnit(0), counters()
+    {
+        for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (int index = 0; index < TEXTURE_TARGETS; index++)
+                textures[unit][index] = 0;
+    }
+};
+#endif
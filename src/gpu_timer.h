@@ -0,0 +1,84 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Measures GPU time of a repeated pass (typically one per frame) with GL_TIME_ELAPSED queries. The queries are kept
+// in a ring and a result is only read back when its slot comes round again, by which time the GPU has long finished
+// it, so timing never stalls the pipeline. Results therefore arrive a few frames late, in submission order. With
+// waitForResults off, a result still not available when its slot is reused is given up (recorded as NaN) instead of
+// waited for, which keeps even a shallow ring stall-free.
+class GpuTimer
+{
+public:
+    // GPU time of every completed measurement, in milliseconds
+    std::vector<double> results;
+
+    explicit GpuTimer(int depth = 4, bool waitForResults = true)
+        : queries(depth), pending(depth, false), next(0), waitForResults(waitForResults)
+    {
+        glGenQueries(depth, queries.data());
+    }
+
+    ~GpuTimer()
+    {
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    // starts a measurement; collects the result that previously used this slot first
+    void begin()
+    {
+        if (pending[next])
+            collect(next, waitForResults);
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[next] = true;
+        next = (next + 1) % queries.size();
+    }
+
+    // reads back every outstanding measurement, waiting for the GPU if needed (use at shutdown)
+    void finish()
+    {
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            size_t slot = (next + i) % queries.size();
+            if (pending[slot])
+                collect(slot, true);
+        }
+    }
+
+private:
+    std::vector<GLuint> queries;
+    std::vector<bool> pending;
+    size_t next;
+    bool waitForResults;
+
+    void collect(size_t slot, bool wait)
+    {
+        GLint available = GL_TRUE;
+        if (!wait)
+            glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            results.push_back(std::numeric_limits<double>::quiet_NaN());
+            pending[slot] = false;
+            return;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+        results.push_back(nanoseconds / 1.0e6);
+        pending[slot] = false;
+    }
+};
+#endif
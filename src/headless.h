@@ -0,0 +1,195 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+// model.h defines STB_IMAGE_IMPLEMENTATION, so stb_image.h must not be included a second time after it
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Options of the headless benchmark/regression mode:
+//   --headless [frames]     render `frames` frames (default 300) into an offscreen framebuffer, without vsync
+//   --osmesa                create the context through OSMesa on GLFW's null platform (no display or GPU needed)
+//   --dump-frame N          write frame N to <output-dir>/frame_N.png (repeatable)
+//   --output-dir DIR        where frame dumps and frame_times.csv go (default ".")
+//   --golden-dir DIR        compare each dumped frame with DIR/frame_N.png and fail on differences
+//   --tolerance T           largest per-channel difference (0-255) still accepted by the comparison (default 2)
+struct HeadlessOptions {
+    bool enabled;
+    bool osmesa;
+    int frames;
+    vector<int> dumpFrames;
+    string outputDir;
+    string goldenDir;
+    int tolerance;
+
+    HeadlessOptions() : enabled(false), osmesa(false), frames(300), outputDir("."), tolerance(2) {}
+
+    bool dumps(int frame) const
+    {
+        return find(dumpFrames.begin(), dumpFrames.end(), frame) != dumpFrames.end();
+    }
+};
+
+inline HeadlessOptions parseHeadlessOptions(int argc, char **argv)
+{
+    HeadlessOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            options.enabled = true;
+            if (hasValue && argv[i + 1][0] != '-')
+                options.frames = max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--osmesa") == 0)
+            options.osmesa = true;
+        else if (strcmp(argv[i], "--dump-frame") == 0 && hasValue)
+            options.dumpFrames.push_back(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--output-dir") == 0 && hasValue)
+            options.outputDir = argv[++i];
+        else if (strcmp(argv[i], "--golden-dir") == 0 && hasValue)
+            options.goldenDir = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && hasValue)
+            options.tolerance = atoi(argv[++i]);
+    }
+    return options;
+}
+
+// Offscreen render target: RGBA8 colour and 24-bit depth renderbuffers of a fixed size
+class Framebuffer
+{
+public:
+    GLuint ID;
+    int width, height;
+
+    Framebuffer(int width, int height) : width(width), height(height)
+    {
+        glGenFramebuffers(1, &ID);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, ID);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::FRAMEBUFFER:: offscreen framebuffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~Framebuffer()
+    {
+        glDeleteFramebuffers(1, &ID);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+
+    Framebuffer(const Framebuffer &) = delete;
+    Framebuffer &operator=(const Framebuffer &) = delete;
+
+    void bind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, ID);
+        glViewport(0, 0, width, height);
+    }
+
+    // RGB pixels, top row first
+    vector<unsigned char> readPixels()
+    {
+        vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, ID);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        // GL returns the bottom row first
+        size_t rowBytes = static_cast<size_t>(width) * 3;
+        for (int y = 0; y < height / 2; y++)
+            swap_ranges(pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes, pixels.begin() + (height - 1 - y) * rowBytes);
+        return pixels;
+    }
+
+private:
+    GLuint renderbuffers[2];
+};
+
+// compares a frame with its golden image; prints the result and returns false on a mismatch or a missing golden image
+inline bool compareWithGolden(const vector<unsigned char> &pixels, int width, int height, const string &goldenPath, int tolerance)
+{
+    int goldenWidth, goldenHeight, components;
+    unsigned char *golden = stbi_load(goldenPath.c_str(), &goldenWidth, &goldenHeight, &components, 3);
+    if (!golden)
+    {
+        cout << "  " << goldenPath << ": missing golden image" << endl;
+        return false;
+    }
+    bool sameSize = goldenWidth == width && goldenHeight == height;
+    int maxDiff = 0;
+    size_t differing = 0;
+    if (sameSize)
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            int diff = abs(static_cast<int>(pixels[i]) - static_cast<int>(golden[i]));
+            maxDiff = max(maxDiff, diff);
+            if (diff > tolerance)
+                differing++;
+        }
+    stbi_image_free(golden);
+
+    if (!sameSize)
+    {
+        cout << "  " << goldenPath << ": FAIL, size " << goldenWidth << "x" << goldenHeight << " instead of " << width << "x" << height << endl;
+        return false;
+    }
+    cout << "  " << goldenPath << ": " << (differing == 0 ? "ok" : "FAIL") << ", max channel difference " << maxDiff
+         << ", " << differing << " channels above tolerance" << endl;
+    return differing == 0;
+}
+
+// prints min/avg/max of the per-frame CPU and GPU times and writes all of them to <output-dir>/frame_times.csv
+inline void reportFrameTimes(const vector<double> &cpuMs, const vector<double> &gpuMs, const string &outputDir)
+{
+    auto summary = [](const char *label, const vector<double> &times) {
+        if (times.empty())
+            return;
+        double total = 0.0;
+        for (double t : times)
+            total += t;
+        cout << "  " << label << ": min " << *min_element(times.begin(), times.end()) << " ms, avg " << total / times.size()
+             << " ms, max " << *max_element(times.begin(), times.end()) << " ms" << endl;
+    };
+    cout << fixed << setprecision(3);
+    cout << "headless run: " << cpuMs.size() << " frames" << endl;
+    summary("cpu", cpuMs);
+    summary("gpu", gpuMs);
+
+    string csvPath = outputDir + "/frame_times.csv";
+    ofstream csv(csvPath.c_str());
+    csv << "frame,cpu_ms,gpu_ms" << endl;
+    for (size_t i = 0; i < cpuMs.size(); i++)
+    {
+        csv << i << "," << cpuMs[i] << ",";
+        if (i < gpuMs.size())
+            csv << gpuMs[i];
+        csv << endl;
+    }
+    cout << "  per-frame times written to " << csvPath << endl;
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// first attribute location used by per-instance data; 0-6 are taken by Vertex
+#define INSTANCE_ATTRIBUTE_LOCATION 7
+
+// Per-instance attributes read by instanced shaders (see ballShader.vs)
+struct InstanceData {
+    // model matrix, occupies locations 7-10
+    glm::mat4 model;
+    // base colour, location 11
+    glm::vec4 color;
+    // location 12: x = ball number, y = 1 for striped balls, zw unused
+    glm::vec4 params;
+};
+
+// Vertex buffer of InstanceData with one entry per instance, drawn through Model::DrawInstanced
+class InstanceBuffer
+{
+public:
+    GLuint ID;
+    GLsizei count;
+
+    InstanceBuffer() : count(0), capacity(0)
+    {
+        glGenBuffers(1, &ID);
+    }
+
+    ~InstanceBuffer()
+    {
+        glDeleteBuffers(1, &ID);
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces the instance data; the storage is only reallocated when it grows
+    void update(const std::vector<InstanceData> &instances)
+    {
+        count = static_cast<GLsizei>(instances.size());
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        if (instances.size() > capacity)
+        {
+            capacity = instances.size();
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+        }
+        else if (!instances.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // points the instance attributes of the currently bound VAO at this buffer, advancing once per instance
+    void attach() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + column);
+            glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + column, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 4);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, color));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 4, 1);
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 5);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, params));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 5, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // disables the instance attributes of the currently bound VAO
+    static void detach()
+    {
+        for (GLuint location = INSTANCE_ATTRIBUTE_LOCATION; location < INSTANCE_ATTRIBUTE_LOCATION + 6; location++)
+            glDisableVertexAttribArray(location);
+    }
+
+private:
+    size_t capacity;
+};
+#endif
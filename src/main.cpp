@@ -7,41 +7,246 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 
 #include "camera.h"
 #include "shader.h"
 #include "model.h"
+#include "model_loader.h"
+#include "static_scene.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "shader_watcher.h"
+#include "uniform_buffer.h"
+#include "physics.h"
+#include "event_simulation.h"
+#include "shot_search.h"
+#include "benchmark.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+#include "headless.h"
+
+#include <chrono>
+#include <memory>
+
+#include <cfloat>
+#include <cstring>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, float deltaTime);
+int runScene(GLFWwindow* window, const HeadlessOptions &options);
 
 // Display size
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
 
+// The scene is in meters, like the simulation. The playing surface of the table model is 0.919 units long with the
+// cloth at height 0.257, so the model is scaled to the real table length and table space sits on its cloth.
+const float TABLE_MODEL_SCALE = Table::LENGTH / 0.919f;
+const glm::vec3 TABLE_SURFACE_CENTER = glm::vec3(0.0f, 0.257f, 0.0005f) * TABLE_MODEL_SCALE;
+// the room model is drawn at 1.5 times the table model's scale
+const float ROOM_MODEL_SCALE = 1.5f * TABLE_MODEL_SCALE;
+
 // Camera (with initial position)
-Camera camera(glm::vec3(0.0f, 10.0f, 20.0f));
+Camera camera(glm::vec3(0.0f, 2.75f, 5.5f));
+// keyboard rotation speed, in Camera::MovementSpeed degrees per second
+const float CAMERA_TURN_RATE = 60.0f;
+// projection depth range, in meters
+const float CAMERA_NEAR = 0.03f;
+const float CAMERA_FAR = 30.0f;
+
+// Profiler overlay (P, or --profile) and the Chrome trace written at exit (--trace FILE)
+bool showProfiler = false;
+std::string tracePath;
+
+glm::vec3 lightPos(0.0f, 4.15f, 0.0f);
+
+// GPU vertex layout of the scene models; --full-vertices uploads the full float vertices for comparison
+VertexLayout sceneVertexLayout = VERTEX_COMPACT;
+// the table and room are submitted with one multi-draw indirect call where supported; --no-indirect draws them one
+// by one for comparison
+bool allowIndirect = true;
+// meshes of the table and room outside the view frustum are skipped; --no-cull draws them all for comparison
+bool cullMeshes = true;
+// meshes are drawn at the coarsest level of detail that stays within a pixel of the full mesh on screen; --no-lod
+// draws the full meshes for comparison
+bool useLods = true;
+
+// Ball simulation, in table space (meters, see table.h). Shots are resolved by the event-driven simulation and played
+// back by sampling it; --fixed-step steps the fixed-timestep world every frame instead.
+EventSimulation shots;
+PhysicsWorld physics;
+bool fixedStepPhysics = false;
+// state of the balls shown this frame, from whichever simulation runs
+const BallSet &displayedBalls()
+{
+    return fixedStepPhysics ? physics.balls : shots.balls;
+}
+// orientation of every ball, integrated from the simulated angular velocity for display only
+glm::quat ballOrientation[Table::BALL_COUNT];
 
+// Shot hints (H) and the shot they suggest, played with Enter
+ShotSearch shotSearch;
+ShotSearchResult hint;
 
+// colour of a ball by number (0 = cue ball); 9-15 are the striped versions of 1-7
+glm::vec4 ballColor(int number)
+{
+    static const glm::vec4 colors[] = {
+        glm::vec4(1.00f, 1.00f, 1.00f, 1.0f), // cue
+        glm::vec4(0.95f, 0.75f, 0.05f, 1.0f), // yellow
+        glm::vec4(0.05f, 0.15f, 0.70f, 1.0f), // blue
+        glm::vec4(0.80f, 0.05f, 0.05f, 1.0f), // red
+        glm::vec4(0.35f, 0.05f, 0.45f, 1.0f), // purple
+        glm::vec4(0.95f, 0.40f, 0.05f, 1.0f), // orange
+        glm::vec4(0.05f, 0.45f, 0.15f, 1.0f), // green
+        glm::vec4(0.45f, 0.05f, 0.05f, 1.0f), // maroon
+        glm::vec4(0.02f, 0.02f, 0.02f, 1.0f)  // black
+    };
+    return colors[number > 8 ? number - 8 : number];
+}
 
-glm::vec3 lightPos(0.0f, 15.0f, 0.0f);
+// rolls the displayed balls by their angular velocity over the last frame
+void updateBallOrientations(float deltaTime)
+{
+    const BallSet &balls = displayedBalls();
+    for (int i = 0; i < Table::BALL_COUNT; i++)
+    {
+        glm::vec3 w(balls.wx[i], balls.wy[i], balls.wz[i]);
+        float speed = glm::length(w);
+        if (speed > 0.0f)
+            ballOrientation[i] = glm::normalize(glm::angleAxis(speed * deltaTime, w / speed) * ballOrientation[i]);
+    }
+}
 
+// instance data of every ball still in play, placed from the simulation
+vector<InstanceData> ballInstances()
+{
+    const BallSet &balls = displayedBalls();
+    vector<InstanceData> instances;
+    for (int i = 0; i < Table::BALL_COUNT; i++)
+    {
+        if (!(balls.flags[i] & BALL_IN_PLAY))
+            continue;
+        glm::vec3 position = TABLE_SURFACE_CENTER + glm::vec3(balls.px[i], Table::BALL_RADIUS, balls.pz[i]);
+        InstanceData instance;
+        instance.model = glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(ballOrientation[i])
+                         * glm::scale(glm::mat4(1.0f), glm::vec3(Table::BALL_RADIUS));
+        instance.color = ballColor(i);
+        instance.params = glm::vec4(static_cast<float>(i), i > 8 ? 1.0f : 0.0f, 0.0f, 0.0f);
+        instances.push_back(instance);
+    }
+    return instances;
+}
 
+// distance from `eye` to the surface of the nearest ball in play; the balls are drawn in one instanced draw, at the
+// level of detail this one needs
+float nearestBallDistance(const glm::vec3 &eye)
+{
+    const BallSet &balls = displayedBalls();
+    float nearest = FLT_MAX;
+    for (int i = 0; i < Table::BALL_COUNT; i++)
+        if (balls.flags[i] & BALL_IN_PLAY)
+        {
+            glm::vec3 position = TABLE_SURFACE_CENTER + glm::vec3(balls.px[i], Table::BALL_RADIUS, balls.pz[i]);
+            nearest = std::min(nearest, glm::length(position - eye) - Table::BALL_RADIUS);
+        }
+    return nearest;
+}
 
-int main()
+// Handles of the material and model uniforms of the table, room and ball shaders; camera and light come from uniform buffers
+struct SceneUniforms
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    Uniform materialAmbient, materialDiffuse, materialSpecular, materialShininess;
+    Uniform model;
 
+    explicit SceneUniforms(Shader &shader)
+        : materialAmbient(shader.uniform("material.ambient")), materialDiffuse(shader.uniform("material.diffuse")),
+          materialSpecular(shader.uniform("material.specular")), materialShininess(shader.uniform("material.shininess")),
+          model(shader.uniform("model"))
+    {
+        shader.bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+        shader.bindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING);
+    }
+};
 
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "BilliardGL", NULL, NULL);
+// sets the material uniforms on a shader, which must be in use
+void setMaterialUniforms(Shader &shader, const SceneUniforms &uniforms)
+{
+    shader.setVector3f(uniforms.materialAmbient, 1.0f, 0.5f, 0.31f);
+    shader.setVector3f(uniforms.materialDiffuse, 1.0f, 0.5f, 0.31f);
+    shader.setVector3f(uniforms.materialSpecular, 0.5f, 0.5f, 0.5f);
+    shader.setFloat(uniforms.materialShininess, 32.0f);
+}
+
+// creates the window and its context; headless runs use an invisible window, on GLFW's null platform with an OSMesa
+// context when asked to or when no display is available
+GLFWwindow* createWindow(HeadlessOptions &options)
+{
+    for (;;)
+    {
+        // glfw: initialize and configure
+        if (options.osmesa)
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        if (!glfwInit())
+        {
+            if (!options.enabled || options.osmesa)
+                return NULL;
+            std::cout << "No display available, retrying headless with OSMesa" << std::endl;
+            options.osmesa = true;
+            continue;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        if (options.enabled)
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (options.osmesa)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+        // glfw window creation
+        GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "BilliardGL", NULL, NULL);
+        if (window != NULL || !options.enabled || options.osmesa)
+            return window;
+        std::cout << "Failed to create a hidden window, retrying headless with OSMesa" << std::endl;
+        glfwTerminate();
+        options.osmesa = true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options = parseHeadlessOptions(argc, argv);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--fixed-step") == 0)
+            fixedStepPhysics = true;
+        else if (strcmp(argv[i], "--full-vertices") == 0)
+            sceneVertexLayout = VERTEX_FULL;
+        else if (strcmp(argv[i], "--no-indirect") == 0)
+            allowIndirect = false;
+        else if (strcmp(argv[i], "--no-cull") == 0)
+            cullMeshes = false;
+        else if (strcmp(argv[i], "--no-program-cache") == 0)
+            ProgramCache::enabled() = false;
+        else if (strcmp(argv[i], "--no-compressed-textures") == 0)
+            Dds::enabled() = false;
+        else if (strcmp(argv[i], "--no-obj-parser") == 0)
+            ObjParser::enabled() = false;
+        else if (strcmp(argv[i], "--no-mesh-optimizer") == 0)
+            MeshOptimizer::enabled() = false;
+        else if (strcmp(argv[i], "--no-lod") == 0)
+            useLods = false;
+        else if (strcmp(argv[i], "--profile") == 0)
+            showProfiler = true;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+    }
+
+    GLFWwindow* window = createWindow(options);
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -59,166 +264,423 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // .dds textures are BC1/BC3 (S3TC) or BC5 (RGTC, core since 3.0)
+    Dds::enabled() = Dds::enabled() && GLAD_GL_EXT_texture_compression_s3tc;
 
 
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
 
-    // Shaders (as for now, roomShader=tableShader but duplicated for future proofing)
-    Shader tableShader("../models/table/tableShader.vs", "../models/table/tableShader.fs");
-    Shader roomShader("../models/room/roomShader.vs", "../models/room/roomShader.fs");
-    Shader reflectiveBallShader("../models/balls/ballShader.vs", "../models/balls/ballShader.fs");
+    // command line benchmarks run instead of the scene
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench-startup") == 0)
+        {
+            Benchmark::startup({ "../models/table/pooltable.obj", "../models/room/room.obj", "../models/balls/sphere.obj" });
+            Benchmark::programs({ { "../models/static/staticShader.vs", "../models/static/staticShader.fs", "#define COMPACT_VERTEX\n" },
+                                  { "../models/balls/ballShader.vs", "../models/balls/ballShader.fs", "#define COMPACT_VERTEX\n" },
+                                  { "../models/overlay/overlayShader.vs", "../models/overlay/overlayShader.fs", "" } });
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-textures") == 0)
+        {
+            Benchmark::textures({ "../models/table/pooltable.obj", "../models/room/room.obj" });
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-obj") == 0)
+        {
+            Benchmark::objImport({ "../models/room/room.obj", "../models/table/pooltable.obj" });
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-mesh-optimizer") == 0)
+        {
+            Benchmark::meshOptimizer({ "../models/room/room.obj", "../models/table/pooltable.obj", "../models/balls/sphere.obj" });
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-lod") == 0)
+        {
+            {
+                Shader shader("../models/balls/ballShader.vs", "../models/balls/ballShader.fs", Model::vertexDefines(VERTEX_COMPACT));
+                SceneUniforms uniforms(shader);
+                shader.use();
+                setMaterialUniforms(shader, uniforms);
+                Benchmark::lod("../models/balls/sphere.obj", shader, camera, SCR_WIDTH, SCR_HEIGHT, Table::BALL_RADIUS);
+            }
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-vertices") == 0)
+        {
+            Benchmark::vertices({ "../models/room/room.obj", "../models/table/pooltable.obj" });
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-shots") == 0)
+        {
+            Benchmark::shotSearch();
+            glfwTerminate();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-uniforms") == 0)
+        {
+            {
+                Shader shader("../models/table/tableShader.vs", "../models/table/tableShader.fs");
+                Benchmark::uniforms(shader);
+            }
+            glfwTerminate();
+            return 0;
+        }
+    }
 
-    // Models
-    Model tableModel("../models/table/pooltable.obj");
-    Model roomModel("../models/room/room.obj");
-    Model reflectiveBallModel("../models/balls/sphere.obj");
+    // all GL objects of the scene are released inside runScene, while the context still exists
+    int result = runScene(window, options);
 
-    // Position the light
-    const glm::vec3 light_pos = glm::vec3(0.0, 3.0, 0.0);
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    glfwTerminate();
+    return result;
+}
+
+// loads the scene and runs the render loop, on screen or headless; returns the process exit code
+int runScene(GLFWwindow* window, const HeadlessOptions &options)
+{
+    // Models, loaded in the background while the render loop already runs; each is drawn once it is uploaded
+    ModelLoader loader;
+    ModelLoader::Handle tableHandle = loader.load("../models/table/pooltable.obj", sceneVertexLayout);
+    ModelLoader::Handle roomHandle = loader.load("../models/room/room.obj", sceneVertexLayout);
+    ModelLoader::Handle reflectiveBallHandle = loader.load("../models/balls/sphere.obj", sceneVertexLayout);
+
+    // The table and the room never move: their draws, transforms and textures are uploaded once and submitted as one batch
+    glm::mat4 pooltable = glm::mat4(1.0f);
+    pooltable = glm::translate(pooltable, glm::vec3(0.0f, 0.0f, 0.0f)); // position in the scene
+    pooltable = glm::scale(pooltable, glm::vec3(TABLE_MODEL_SCALE));        // scale
+    glm::mat4 room = glm::mat4(1.0f);
+    room = glm::translate(room, glm::vec3(0.0f, 0.0f, 0.0f)); // position in the scene
+    room = glm::scale(room, glm::vec3(ROOM_MODEL_SCALE));        // scale
+    // built once both models are complete, as their textures are copied into the batch's texture array
+    StaticScene staticScene(sceneVertexLayout, allowIndirect);
+    staticScene.culling = cullMeshes;
+
+    // Shaders, compiled for the vertex layout the models are loaded with (none of them is skinned, which would force the
+    // full layout)
+    Shader staticShader("../models/static/staticShader.vs", "../models/static/staticShader.fs", staticScene.shaderDefines());
+    Shader reflectiveBallShader("../models/balls/ballShader.vs", "../models/balls/ballShader.fs", Model::vertexDefines(sceneVertexLayout));
+
+    // Resolve the uniforms once so the render loop does no name lookups
+    SceneUniforms staticUniforms(staticShader);
+    SceneUniforms reflectiveBallUniforms(reflectiveBallShader);
+    Uniform refractionIndexUniform = reflectiveBallShader.uniform("Material.refractionIndex");
+
+    // The material uniforms never change, so they are set once rather than every frame
+    staticShader.use();
+    setMaterialUniforms(staticShader, staticUniforms);
+    reflectiveBallShader.use();
+    setMaterialUniforms(reflectiveBallShader, reflectiveBallUniforms);
+    reflectiveBallShader.setFloat(refractionIndexUniform, 0.2f);
+
+    // Edited shader files are rebuilt and swapped in while running; a new program gets the load-time uniforms again
+    ShaderWatcher shaderWatcher("../models");
+    shaderWatcher.watch(staticShader, [&](Shader &shader) { setMaterialUniforms(shader, staticUniforms); });
+    shaderWatcher.watch(reflectiveBallShader, [&](Shader &shader) {
+        setMaterialUniforms(shader, reflectiveBallUniforms);
+        shader.setFloat(refractionIndexUniform, 0.2f);
+    });
+
+    // Draws of the frame, issued sorted by program, texture, vertex array and depth
+    RenderQueue renderQueue;
+
+    // Ball transforms and colours, one instance per ball, refreshed every frame from the simulation
+    InstanceBuffer ballInstanceBuffer;
+    for (int i = 0; i < Table::BALL_COUNT; i++)
+        ballOrientation[i] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+    // Per-frame camera and light state, shared by all programs
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<LightBlock> lightBuffer(LIGHT_BLOCK_BINDING);
+
+    // Named CPU scopes and GPU passes; headless runs time the whole frame with their own query, which GPU passes can't nest in
+    Profiler profiler;
+    profiler.gpuEnabled = !options.enabled;
+    if (!tracePath.empty())
+        profiler.startTrace();
+
+    // Headless runs render offscreen as fast as possible and time every frame
+    std::unique_ptr<Framebuffer> offscreen;
+    std::unique_ptr<GpuTimer> gpuTimer;
+    std::vector<double> cpuFrameMs;
+    bool goldenMatch = true;
+    if (options.enabled)
+    {
+        offscreen.reset(new Framebuffer(SCR_WIDTH, SCR_HEIGHT));
+        gpuTimer.reset(new GpuTimer());
+        glfwSwapInterval(0);
+    }
+    else
+        glfwSwapInterval(1);
 
-    glfwSwapInterval(1);
+    // headless frames must not depend on how fast the models load
+    if (options.enabled)
+        loader.finish();
 
     // Main render loop
-    while (!glfwWindowShouldClose(window))
+    float lastFrame = static_cast<float>(glfwGetTime());
+    for (int frame = 0; options.enabled ? frame < options.frames : !glfwWindowShouldClose(window); frame++)
     {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        profiler.beginFrame();
+        // headless runs advance a fixed 60 Hz per frame so their output doesn't depend on how fast they render
+        float currentFrame = static_cast<float>(glfwGetTime());
+        float deltaTime = options.enabled ? 1.0f / 60.0f : currentFrame - lastFrame;
+        lastFrame = currentFrame;
 
         // input
-        processInput(window);
+        if (options.enabled)
+        {
+            offscreen->bind();
+            gpuTimer->begin();
+        }
+        else
+        {
+            Profiler::CpuScope scope = profiler.cpu("input");
+            processInput(window, deltaTime);
+            shaderWatcher.update();
+        }
+        profiler.overlayVisible = showProfiler;
+
+        // uploads of the models being loaded, within the per-frame budget
+        {
+            Profiler::CpuScope scope = profiler.cpu("load");
+            if (!loader.idle())
+            {
+                loader.update();
+                if (loader.idle())
+                {
+                    TextureCache::Stats textures = TextureCache::shared().stats();
+                    std::cout << "models loaded after " << glfwGetTime() * 1000.0 << " ms, frame " << frame << "; "
+                              << textures.textures << " textures (" << textures.bytes / 1024 << " KiB), "
+                              << textures.bytesSaved / 1024 << " KiB saved by sharing; peak RSS "
+                              << Profiler::peakResidentBytes() / 1024 << " KiB" << std::endl;
+                }
+            }
+            if (!staticScene.ready() && loader.complete(tableHandle) && loader.complete(roomHandle))
+            {
+                staticScene.add(*loader.model(tableHandle), pooltable);
+                staticScene.add(*loader.model(roomHandle), room);
+                staticScene.build();
+                std::cout << "static scene: " << staticScene.drawCount() << " draws, "
+                          << (staticScene.indirect ? "multi-draw indirect" : "one draw call each") << ", "
+                          << staticScene.materialArrayCount() << " texture arrays (" << staticScene.materialBytes() / 1024 << " KiB)" << std::endl;
+            }
+        }
+        Model *reflectiveBallModel = loader.model(reflectiveBallHandle);
+
+        // simulation
+        {
+            Profiler::CpuScope scope = profiler.cpu("simulation");
+            if (fixedStepPhysics)
+                physics.update(deltaTime);
+            else
+                shots.update(deltaTime);
+            updateBallOrientations(deltaTime);
+            ballInstanceBuffer.update(ballInstances());
+        }
 
         // render
         glClearColor(0.76f, 0.88f, 1.00f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        tableShader.use();
-        roomShader.use();
-        reflectiveBallShader.use();
-
-        // Set everything for the table
-        // light properties
-        glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
-        glm::vec3 diffuseColor = lightColor   * glm::vec3(0.5f); // decrease the influence
-        glm::vec3 ambientColor = diffuseColor * glm::vec3(0.2f); // low influence
-        tableShader.setVector3f("light.ambient", ambientColor * 7.0f); // multiplied to increase the intensity
-        tableShader.setVector3f("light.diffuse", diffuseColor * 7.0f);
-        tableShader.setVector3f("light.specular", 1.0f, 1.0f, 1.0f);
-
-        // material properties
-        tableShader.setVector3f("material.ambient", 1.0f, 0.5f, 0.31f);
-        tableShader.setVector3f("material.diffuse", 1.0f, 0.5f, 0.31f);
-        tableShader.setVector3f("material.specular", 0.5f, 0.5f, 0.5f);
-        tableShader.setFloat("material.shininess", 32.0f);
-
-
-        // Set everything for the room
-        // light properties
-        roomShader.setVector3f("light.ambient", ambientColor * 7.0f);
-        roomShader.setVector3f("light.diffuse", diffuseColor * 7.0f);
-        roomShader.setVector3f("light.specular", 1.0f, 1.0f, 1.0f);
-
-        // material properties
-        roomShader.setVector3f("material.ambient", 1.0f, 0.5f, 0.31f);
-        roomShader.setVector3f("material.diffuse", 1.0f, 0.5f, 0.31f);
-        roomShader.setVector3f("material.specular", 0.5f, 0.5f, 0.5f);
-        roomShader.setFloat("material.shininess", 32.0f);
-
-
-        // Set everything for the reflective ball
-        // light properties
-        reflectiveBallShader.setVector3f("light.ambient", ambientColor * 7.0f);
-        reflectiveBallShader.setVector3f("light.diffuse", diffuseColor * 7.0f);
-        reflectiveBallShader.setVector3f("light.specular", 1.0f, 1.0f, 1.0f);
-
-        // material properties
-        reflectiveBallShader.setVector3f("material.ambient", 1.0f, 0.5f, 0.31f);
-        reflectiveBallShader.setVector3f("material.diffuse", 1.0f, 0.5f, 0.31f);
-        reflectiveBallShader.setVector3f("material.specular", 0.5f, 0.5f, 0.5f);
-        reflectiveBallShader.setFloat("material.shininess", 32.0f);
-
-
-        // view & projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        tableShader.setMatrix4("projection", projection);
-        tableShader.setMatrix4("view", view);
-
-        roomShader.setMatrix4("projection", projection);
-        roomShader.setMatrix4("view", view);
-
-        reflectiveBallShader.setMatrix4("projection", projection);
-        reflectiveBallShader.setMatrix4("view", view);
-
-
-        tableShader.setVector3f("lightColor", 1.0f, 1.0f, 1.0f);
-        tableShader.setVector3f("light.position", lightPos);
-        tableShader.setVector3f("viewPos", camera.Position);
-
-        roomShader.setVector3f("lightColor", 1.0f, 1.0f, 1.0f);
-        roomShader.setVector3f("light.position", lightPos);
-        roomShader.setVector3f("viewPos", camera.Position);
-
-        reflectiveBallShader.setVector3f("lightColor", 1.0f, 1.0f, 1.0f);
-        reflectiveBallShader.setVector3f("light.position", lightPos);
-        reflectiveBallShader.setVector3f("viewPos", camera.Position);
-        reflectiveBallShader.setFloat("Material.refractionIndex", 0.2f);
-
-        // Render the pool table
-        glm::mat4 pooltable = glm::mat4(1.0f);
-        pooltable = glm::translate(pooltable, glm::vec3(0.0f, 0.0f, 0.0f)); // position in the scene
-        pooltable = glm::scale(pooltable, glm::vec3(10.0f, 10.0f, 10.0f));     // scale
-        tableShader.setMatrix4("model", pooltable);
-        tableModel.Draw(tableShader);
-
-        // Render the room
-        glm::mat4 room = glm::mat4(1.0f);
-        room = glm::translate(room, glm::vec3(0.0f, 0.0f, 0.0f)); // position in the scene
-        room = glm::scale(room, glm::vec3(15.0f, 15.0f, 15.0f));     // scale
-        roomShader.setMatrix4("model", room);
-        roomModel.Draw(roomShader);
-
-        // Render the reflective ball
-        glm::mat4 reflectiveBall = glm::mat4(1.0f);
-        reflectiveBall = glm::translate(reflectiveBall, glm::vec3(4.0f, 2.9f, 1.5f)); // position in the scene
-        reflectiveBall = glm::scale(reflectiveBall, glm::vec3(0.3f, 0.3f, 0.3f));     // scale
-        reflectiveBallShader.setMatrix4("model", reflectiveBall);
-        reflectiveBallModel.Draw(reflectiveBallShader);
+        // per-frame uniform blocks
+        glm::mat4 viewProjection;
+        // pixels a world unit spans at distance 1, for picking levels of detail; FLT_MAX draws the full meshes
+        float pixelsPerUnit = useLods ? camera.GetPixelsPerUnit(static_cast<float>(SCR_HEIGHT)) : FLT_MAX;
+        {
+            Profiler::CpuScope scope = profiler.cpu("uniforms");
+            // light properties
+            glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
+            glm::vec3 diffuseColor = lightColor   * glm::vec3(0.5f); // decrease the influence
+            glm::vec3 ambientColor = diffuseColor * glm::vec3(0.2f); // low influence
+            LightBlock light;
+            light.position = glm::vec4(lightPos, 1.0f);
+            light.ambient = glm::vec4(ambientColor * 7.0f, 0.0f); // multiplied to increase the intensity
+            light.diffuse = glm::vec4(diffuseColor * 7.0f, 0.0f);
+            light.specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+            light.color = glm::vec4(lightColor, 0.0f);
+            lightBuffer.update(light);
+
+            // view & projection transformations
+            CameraBlock cameraData;
+            cameraData.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
+            cameraData.view = camera.GetViewMatrix();
+            cameraData.viewPos = glm::vec4(camera.Position, 1.0f);
+            cameraBuffer.update(cameraData);
+            viewProjection = cameraData.projection * cameraData.view;
+        }
+
+        // Render the scene through the render queue: the pool table and the room in one submission (drawn first, as
+        // they cover most of the screen), then the balls, all of them in one instanced draw per mesh
+        size_t triangles = 0;
+        {
+            Profiler::CpuScope scope = profiler.cpu("draw");
+            staticScene.cull(viewProjection, camera.Position, pixelsPerUnit);
+            triangles = staticScene.triangleCount();
+            if (staticScene.visibleCount() > 0)
+                renderQueue.submit(staticShader, staticScene.materialTexture(), GeometryArena::forLayout(staticScene.layout).vertexArray(), 0.0f, [&] {
+                    Profiler::GpuScope pass = profiler.gpu("static");
+                    staticScene.draw(staticShader);
+                });
+            float ballDepth = glm::length(camera.Position - TABLE_SURFACE_CENTER) / CAMERA_FAR;
+            float ballDistance = nearestBallDistance(camera.Position);
+            float ballPixelsPerUnit = useLods && ballDistance > 0.0f ? pixelsPerUnit * Table::BALL_RADIUS / ballDistance : FLT_MAX;
+            if (reflectiveBallModel)
+            {
+                renderQueue.submit(reflectiveBallShader, 0, GeometryArena::forLayout(reflectiveBallModel->vertexLayout).vertexArray(), ballDepth, [&] {
+                    Profiler::GpuScope pass = profiler.gpu("balls");
+                    reflectiveBallModel->DrawInstanced(reflectiveBallShader, ballInstanceBuffer, ballPixelsPerUnit);
+                });
+                triangles += reflectiveBallModel->triangleCount(ballPixelsPerUnit) * ballInstanceBuffer.count;
+            }
+            renderQueue.flush();
+        }
+
+        // Profiler statistics on top
+        {
+            Profiler::CpuScope scope = profiler.cpu("overlay");
+            Profiler::GpuScope pass = profiler.gpu("overlay");
+            profiler.drawOverlay(SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        // program, texture and vertex array binds issued and skipped by GLState this frame
+        GLState::Counters binds = GLState::current().takeCounters();
+        profiler.count("program binds", static_cast<double>(binds.programs.issued));
+        profiler.count("program skips", static_cast<double>(binds.programs.skipped));
+        profiler.count("texture binds", static_cast<double>(binds.textures.issued));
+        profiler.count("texture skips", static_cast<double>(binds.textures.skipped));
+        profiler.count("vao binds", static_cast<double>(binds.vertexArrays.issued));
+        profiler.count("vao skips", static_cast<double>(binds.vertexArrays.skipped));
+        profiler.count("meshes drawn", static_cast<double>(staticScene.visibleCount()));
+        profiler.count("meshes culled", static_cast<double>(staticScene.culledCount()));
+        profiler.count("triangles", static_cast<double>(triangles));
+
+        if (options.enabled)
+        {
+            gpuTimer->end();
+            cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            if (options.dumps(frame))
+            {
+                std::vector<unsigned char> pixels = offscreen->readPixels();
+                std::string name = "/frame_" + std::to_string(frame) + ".png";
+                stbi_write_png((options.outputDir + name).c_str(), SCR_WIDTH, SCR_HEIGHT, 3, pixels.data(), SCR_WIDTH * 3);
+                if (!options.goldenDir.empty())
+                    goldenMatch = compareWithGolden(pixels, SCR_WIDTH, SCR_HEIGHT, options.goldenDir + name, options.tolerance) && goldenMatch;
+            }
+            glfwPollEvents();
+            profiler.endFrame();
+            continue;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        {
+            Profiler::CpuScope scope = profiler.cpu("swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        if (frame == 0)
+            std::cout << "first frame after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+        profiler.endFrame();
     }
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    glfwTerminate();
+    if (!tracePath.empty())
+        profiler.writeTrace(tracePath);
+    if (options.enabled)
+    {
+        gpuTimer->finish();
+        reportFrameTimes(cpuFrameMs, gpuTimer->results, options.outputDir);
+        return goldenMatch ? 0 : 1;
+    }
     return 0;
+
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, float deltaTime)
 {
     // Use the cameras class to change the parameters of the camera
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboardMovement(LEFT, 0.1);
+        camera.ProcessKeyboardMovement(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboardMovement(RIGHT, 0.1);
+        camera.ProcessKeyboardMovement(RIGHT, deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboardMovement(FORWARD, 0.1);
+        camera.ProcessKeyboardMovement(FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboardMovement(BACKWARD, 0.1);
+        camera.ProcessKeyboardMovement(BACKWARD, deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        camera.ProcessKeyboardRotation(1, 0.0,1);
+        camera.ProcessKeyboardRotation(CAMERA_TURN_RATE, 0.0, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        camera.ProcessKeyboardRotation(-1, 0.0,1);
+        camera.ProcessKeyboardRotation(-CAMERA_TURN_RATE, 0.0, deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        camera.ProcessKeyboardRotation(0.0, 1.0, 1);
+        camera.ProcessKeyboardRotation(0.0, CAMERA_TURN_RATE, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-        camera.ProcessKeyboardRotation(0.0, -1.0, 1);
+        camera.ProcessKeyboardRotation(0.0, -CAMERA_TURN_RATE, deltaTime);
+
+    // Profiler overlay (P)
+    static bool profilerKeyDown = false;
+    bool profilerKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (profilerKey && !profilerKeyDown)
+        showProfiler = !showProfiler;
+    profilerKeyDown = profilerKey;
+
+    // Break (space) once the balls are at rest, re-rack (R)
+    const BallSet &balls = displayedBalls();
+    bool atRest = fixedStepPhysics ? !physics.moving() : !shots.moving();
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && atRest && (balls.flags[0] & BALL_IN_PLAY))
+    {
+        if (fixedStepPhysics)
+            physics.strike(0, glm::pi<float>(), 8.0f);
+        else
+        {
+            shots.strike(0, glm::pi<float>(), 8.0f);
+            if (shots.truncated)
+                std::cout << "shot truncated after " << shots.eventCount << " events, balls may pass through each other" << std::endl;
+        }
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+    {
+        physics.rack();
+        shots.rack();
+        hint.best.clear();
+    }
+
+    // Hint (H): search the best shots from the current position for 50 ms; Enter plays the best one
+    static bool hintKeyDown = false;
+    bool hintKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (hintKey && !hintKeyDown && atRest && !fixedStepPhysics && (balls.flags[0] & BALL_IN_PLAY))
+    {
+        hint = shotSearch.search(balls, 50.0);
+        std::cout << "hint: " << hint.evaluated << " of " << hint.candidates << " shots in " << hint.milliseconds << " ms";
+        if (hint.truncated > 0)
+            std::cout << ", " << hint.truncated << " truncated shots dropped";
+        std::cout << std::endl;
+        for (const ShotOutcome &outcome : hint.best)
+            std::cout << "  angle " << glm::degrees(outcome.shot.angle) << " speed " << outcome.shot.speed << " follow "
+                      << outcome.shot.follow << " side " << outcome.shot.side << ": score " << outcome.score << ", "
+                      << outcome.pocketed << " pocketed" << (outcome.scratch ? ", scratch" : "") << std::endl;
+    }
+    hintKeyDown = hintKey;
+    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && atRest && !fixedStepPhysics && !hint.best.empty())
+    {
+        const Shot &shot = hint.best.front().shot;
+        shots.strike(0, shot.angle, shot.speed, shot.follow, shot.side);
+        hint.best.clear();
+    }
 
 }
 
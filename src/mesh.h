@@ -7,66 +7,177 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "instance_buffer.h"
+#include "geometry_arena.h"
+#include "vertex_convert.h"
+#include "vertex_format.h"
+#include "frustum.h"
 
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// a simplified version of a mesh (see mesh_simplifier.h): triangles over a subset of the same vertices, and how far, in
+// model units, its surface may be from the full mesh's
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error;
+};
+
+// largest error, in pixels on screen, a level of detail may show (Mesh::lodFor)
+const float LOD_PIXEL_ERROR = 1.0f;
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data; the vertices and indices are empty after upload unless the mesh was built with keepGeometry
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    // where the mesh's vertices and indices live in the arena of its layout
+    GeometryArena::Range range;
+    // layout of the vertex buffer on the GPU and the ranges the compact layout is decoded with
+    VertexLayout layout;
+    VertexQuantization quantization;
+    // whether the source mesh has bone weights (those always use the full layout)
+    bool skinned;
+    // model-space bounds of the vertices, for culling
+    Aabb bounds;
+    BoundingSphere sphere;
+    // the coarser levels of detail, in the arena right after the full mesh's indices and sharing its vertices, and the
+    // model-space error of each; level 0 is the full mesh (`range`), level i > 0 is lods[i - 1]
+    vector<GeometryArena::Range> lods;
+    vector<float> lodErrors;
+
+    // constructor; pass the vectors with std::move to hand them over without copying. Once uploaded, the vertices and
+    // indices are freed unless keepGeometry asks to keep them on the CPU (for physics or picking); the levels of detail
+    // are always freed.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexLayout layout = VERTEX_COMPACT,
+         bool skinned = false, bool keepGeometry = false, vector<MeshLod> levels = vector<MeshLod>())
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+          layout(skinned ? VERTEX_FULL : layout), skinned(skinned), samplerRevision(0)
+    {
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        setupMesh(levels);
+        if (!keepGeometry)
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<unsigned int>().swap(this->indices);
+        }
+    }
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // bytes of vertex data uploaded to the GPU
+    size_t vertexBufferSize() const
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        return static_cast<size_t>(range.vertexCount) * (layout == VERTEX_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex));
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    GeometryArena &arena() const
+    {
+        return GeometryArena::forLayout(layout);
+    }
+
+    // the coarsest level whose error stays within LOD_PIXEL_ERROR pixels when one model unit covers `pixelsPerUnit`
+    // pixels on screen
+    size_t lodFor(float pixelsPerUnit) const
+    {
+        size_t level = 0;
+        while (level < lodErrors.size() && lodErrors[level] * pixelsPerUnit <= LOD_PIXEL_ERROR)
+            level++;
+        return level;
+    }
+
+    const GeometryArena::Range &lodRange(size_t level) const
+    {
+        return level == 0 ? range : lods[level - 1];
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
+        arena().bind();
+        DrawBound(shader);
+    }
+
+    // render the mesh with its arena already bound (Model::Draw binds it once for all of its meshes)
+    void DrawBound(Shader &shader, size_t level = 0)
+    {
+        bindTextures(shader);
+        arena().draw(lodRange(level));
+    }
+
+    // render one copy of the mesh per entry of the instance buffer with a single draw call
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances)
+    {
+        arena().bind();
+        DrawInstancedBound(shader, instances);
+    }
+
+    void DrawInstancedBound(Shader &shader, const InstanceBuffer &instances, size_t level = 0)
+    {
+        bindTextures(shader);
+        arena().drawInstanced(lodRange(level), instances);
+    }
+
+    // gives the mesh's ranges back to the arena; copies of the mesh share them, so only the owner (Model) calls this
+    void release()
+    {
+        // the levels' indices were allocated together with the full mesh's
+        GeometryArena::Range allocation = range;
+        for (const GeometryArena::Range &lod : lods)
+            allocation.indexCount += lod.indexCount;
+        arena().release(allocation);
+        range = GeometryArena::Range();
+        lods.clear();
+        lodErrors.clear();
+    }
+
+private:
+    // sampler location of each texture and of the dequantization uniforms, for the program they were resolved against
+    vector<GLint> samplerLocations;
+    GLint positionScaleLocation, positionOffsetLocation, texCoordTransformLocation;
+    unsigned int samplerRevision;
+
+    // binds every texture to its own unit and points the matching sampler at it; also sets the ranges compact
+    // vertices are decoded with
+    void bindTextures(const Shader &shader)
+    {
+        // resolve the sampler locations once per linked program instead of building their names every frame
+        if (samplerRevision != shader.revision)
+            resolveSamplers(shader);
+
+        if (layout == VERTEX_COMPACT)
+        {
+            glUniform3fv(positionScaleLocation, 1, &quantization.positionScale[0]);
+            glUniform3fv(positionOffsetLocation, 1, &quantization.positionOffset[0]);
+            glUniform4fv(texCoordTransformLocation, 1, &quantization.texCoordTransform[0]);
+        }
+
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the texture unit
+            glUniform1i(samplerLocations[i], i);
+            // and bind the texture to it, unless it already is
+            GLState::current().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // looks up the sampler uniform of every texture; each texture type is numbered separately (texture_diffuseN, ...)
+    void resolveSamplers(const Shader &shader)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerLocations.resize(textures.size());
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -78,69 +189,54 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerLocations[i] = shader.location((name + number).c_str());
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        positionScaleLocation = shader.location("positionScale");
+        positionOffsetLocation = shader.location("positionOffset");
+        texCoordTransformLocation = shader.location("texCoordTransform");
+        samplerRevision = shader.revision;
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // copies the vertices, in the mesh's layout, and the indices of every level into the shared arena
+    void setupMesh(const vector<MeshLod> &levels)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        computeBounds(vertices.empty() ? nullptr : &vertices[0].Position, vertices.size(), sizeof(Vertex), bounds, sphere);
+        // one index allocation for all levels, the full mesh first; each level is uploaded from its own vector, so the
+        // indices are never gathered into a copy
+        size_t indexCount = indices.size();
+        for (const MeshLod &level : levels)
+            indexCount += level.indices.size();
+        const unsigned int *indexData = levels.empty() ? indices.data() : NULL;
+        if (layout == VERTEX_COMPACT)
+        {
+            quantization = quantizationFor(vertices);
+            vector<CompactVertex> packed(vertices.size());
+            VertexConvert::compact(vertices.data(), vertices.size(), quantization, packed.data());
+            range = arena().allocate(packed.data(), packed.size(), indexData, indexCount);
+        }
+        else
+        {
+            // full vertices need no decoding
+            quantization.positionScale = glm::vec3(1.0f);
+            quantization.positionOffset = glm::vec3(0.0f);
+            quantization.texCoordTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            range = arena().allocate(vertices.data(), vertices.size(), indexData, indexCount);
+        }
+
+        range.indexCount = static_cast<GLsizei>(indices.size());
+        if (!indexData)
+            arena().writeIndices(range.firstIndex, indices.data(), indices.size());
+        size_t firstIndex = range.firstIndex + indices.size();
+        for (const MeshLod &level : levels)
+        {
+            GeometryArena::Range lod = range;
+            lod.firstIndex = firstIndex;
+            lod.indexCount = static_cast<GLsizei>(level.indices.size());
+            arena().writeIndices(lod.firstIndex, level.indices.data(), level.indices.size());
+            lods.push_back(lod);
+            lodErrors.push_back(level.error);
+            firstIndex += level.indices.size();
+        }
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <mesh.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Binary cache of the meshes produced by Model::loadModel. It sits next to the source file (<model>.meshcache) and stores
+// the final Vertex/index arrays of every mesh, its levels of detail and the material texture references, so warm starts
+// skip Assimp and the simplifier entirely.
+// The cache is keyed by the source path, its size and mtime, the Assimp post-process flags (which also record the
+// passes and the importer Model used, see Model::cacheFlags) and the layout of Vertex; any mismatch makes it stale and
+// the model is imported again.
+namespace MeshCache
+{
+    // bump whenever the file layout or the import pipeline changes the produced geometry
+    const uint32_t VERSION = 4;
+    const char MAGIC[8] = { 'B', 'G', 'L', 'M', 'E', 'S', 'H', '\0' };
+
+    struct TextureRef {
+        string type;
+        string path;
+    };
+
+    struct CachedMesh {
+        vector<Vertex>       vertices;
+        vector<unsigned int> indices;
+        vector<TextureRef>   textures;
+        bool                 skinned;
+        vector<MeshLod>      lods;
+    };
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t postProcessFlags;
+        uint32_t meshCount;
+        uint64_t sourceSize;
+        int64_t  sourceMtime;
+    };
+
+    inline string cachePath(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // fills the source part of the key; returns false if the source file can't be stat'ed
+    inline bool sourceKey(const string &sourcePath, uint64_t &size, int64_t &mtime)
+    {
+        struct stat info;
+        if (stat(sourcePath.c_str(), &info) != 0)
+            return false;
+        size = static_cast<uint64_t>(info.st_size);
+        mtime = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+
+    // reads the cache straight into the meshes' vectors, each array with one fread, so no second copy of the file is
+    // ever held; returns false when there is no valid cache for this key
+    inline bool load(const string &sourcePath, uint32_t postProcessFlags, vector<CachedMesh> &meshes)
+    {
+        uint64_t size;
+        int64_t mtime;
+        if (!sourceKey(sourcePath, size, mtime))
+            return false;
+
+        FILE *file = fopen(cachePath(sourcePath).c_str(), "rb");
+        if (!file)
+            return false;
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        size_t remaining = length > 0 ? static_cast<size_t>(length) : 0;
+        // reads `bytes`, refusing to run past the end of the file (truncated or corrupt file) before allocating for it
+        auto read = [&](void *dst, size_t bytes) {
+            if (remaining < bytes || fread(dst, 1, bytes, file) != bytes)
+                return false;
+            remaining -= bytes;
+            return true;
+        };
+        auto readString = [&](string &str) {
+            uint32_t length;
+            if (!read(&length, sizeof(length)) || remaining < length)
+                return false;
+            str.resize(length);
+            return length == 0 || read(&str[0], length);
+        };
+
+        Header header;
+        bool valid = read(&header, sizeof(Header)) && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION
+                     && header.vertexSize == sizeof(Vertex) && header.postProcessFlags == postProcessFlags
+                     && header.sourceSize == size && header.sourceMtime == mtime;
+        vector<CachedMesh> result(valid ? header.meshCount : 0);
+        for (CachedMesh &mesh : result)
+        {
+            // vertex, index and texture counts, 1 for a skinned mesh, then the number of levels of detail
+            uint32_t counts[5];
+            if (!read(counts, sizeof(counts)))
+            {
+                valid = false;
+                break;
+            }
+            mesh.skinned = counts[3] != 0;
+            // every texture takes at least its two string lengths
+            valid = static_cast<uint64_t>(counts[2]) * 2 * sizeof(uint32_t) <= remaining;
+            if (valid)
+                mesh.textures.resize(counts[2]);
+            for (TextureRef &texture : mesh.textures)
+                valid = valid && readString(texture.type) && readString(texture.path);
+            valid = valid && static_cast<uint64_t>(counts[0]) * sizeof(Vertex) + static_cast<uint64_t>(counts[1]) * sizeof(unsigned int) <= remaining;
+            if (!valid)
+                break;
+            mesh.vertices.resize(counts[0]);
+            mesh.indices.resize(counts[1]);
+            if (!read(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex))
+                || !read(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)))
+            {
+                valid = false;
+                break;
+            }
+            // every level takes at least its index count and error
+            valid = static_cast<uint64_t>(counts[4]) * (sizeof(uint32_t) + sizeof(float)) <= remaining;
+            if (valid)
+                mesh.lods.resize(counts[4]);
+            for (MeshLod &lod : mesh.lods)
+            {
+                uint32_t indexCount;
+                valid = valid && read(&indexCount, sizeof(indexCount)) && read(&lod.error, sizeof(lod.error))
+                        && static_cast<uint64_t>(indexCount) * sizeof(unsigned int) <= remaining;
+                if (!valid)
+                    break;
+                lod.indices.resize(indexCount);
+                valid = read(lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+            }
+            if (!valid)
+                break;
+        }
+        fclose(file);
+        if (!valid)
+            return false;
+        meshes.swap(result);
+        return true;
+    }
+
+    // writes the meshes of a freshly imported model; failures only cost the next start another import
+    inline bool store(const string &sourcePath, uint32_t postProcessFlags, const vector<CachedMesh> &meshes)
+    {
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.postProcessFlags = postProcessFlags;
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        if (!sourceKey(sourcePath, header.sourceSize, header.sourceMtime))
+            return false;
+
+        vector<char> buffer(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header) + sizeof(Header));
+        auto write = [&](const void *src, size_t bytes) {
+            buffer.insert(buffer.end(), static_cast<const char *>(src), static_cast<const char *>(src) + bytes);
+        };
+        auto writeString = [&](const string &str) {
+            uint32_t length = static_cast<uint32_t>(str.size());
+            write(&length, sizeof(length));
+            write(str.data(), str.size());
+        };
+
+        for (const CachedMesh &mesh : meshes)
+        {
+            uint32_t counts[5] = { static_cast<uint32_t>(mesh.vertices.size()),
+                                   static_cast<uint32_t>(mesh.indices.size()),
+                                   static_cast<uint32_t>(mesh.textures.size()),
+                                   mesh.skinned ? 1u : 0u,
+                                   static_cast<uint32_t>(mesh.lods.size()) };
+            write(counts, sizeof(counts));
+            for (const TextureRef &texture : mesh.textures)
+            {
+                writeString(texture.type);
+                writeString(texture.path);
+            }
+            write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            write(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            for (const MeshLod &lod : mesh.lods)
+            {
+                uint32_t indexCount = static_cast<uint32_t>(lod.indices.size());
+                write(&indexCount, sizeof(indexCount));
+                write(&lod.error, sizeof(lod.error));
+                write(lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+            }
+        }
+
+        // write to a temporary name first so a crash never leaves a half-written cache behind
+        string path = cachePath(sourcePath);
+        string tmpPath = path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (!file)
+            return false;
+        bool complete = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        complete = fclose(file) == 0 && complete;
+        remove(path.c_str());
+        if (!complete || rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+#endif
@@ -0,0 +1,394 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh_cache.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <vector>
+
+using namespace std;
+
+// Reorders the triangles and vertices of imported meshes for the GPU, run once at import so the mesh cache stores the
+// result:
+//  0. identical vertices merged, so triangles share them at all (the importers emit one vertex per face corner);
+//  1. triangle order for the post-transform vertex cache, with Tipsify (Sander, Nehab & Barczak, "Fast Triangle
+//     Reordering for Vertex Locality and Reduced Overdraw", 2007): fans around one vertex at a time, moving on to the
+//     neighbour that stays in the cache longest;
+//  2. overdraw: that order is cut into clusters where the simulated cache starts over (and where the running ACMR comes
+//     back close to the cluster's), and the clusters are sorted so the ones facing out from the mesh centre are drawn
+//     first and occlude the rest, giving up at most OVERDRAW_THRESHOLD of the ACMR;
+//  3. vertex fetch: vertices renumbered in order of first use, so the vertex shader reads the buffer front to back.
+// The mesh draws the same; only the order and the number of vertices change. acmr() and overdraw() measure the result
+// (see --bench-mesh-optimizer).
+namespace MeshOptimizer
+{
+    // FIFO entries the cache is optimized for and simulated with; 16 is about what any GPU reuses reliably
+    const unsigned int CACHE_SIZE = 16;
+    // how much worse than the Tipsify order the cluster sort may make the ACMR
+    const float OVERDRAW_THRESHOLD = 1.05f;
+    // square grid overdraw() rasterizes each view into
+    const int OVERDRAW_RESOLUTION = 256;
+
+    // whether Model::import optimizes the meshes it reads; off with --no-mesh-optimizer
+    inline bool &enabled()
+    {
+        static bool value = true;
+        return value;
+    }
+
+    // average cache miss ratio: vertex shader runs per triangle with a FIFO cache of `cacheSize` entries. 0.5 is the
+    // limit for a large regular grid, 3 means no reuse at all.
+    inline float acmr(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE)
+    {
+        if (indices.empty())
+            return 0.0f;
+        // a vertex is cached while fewer than cacheSize misses happened since its own
+        vector<unsigned int> cachedAt(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+        size_t misses = 0;
+        for (unsigned int index : indices)
+            if (time - cachedAt[index] > cacheSize)
+            {
+                cachedAt[index] = time++;
+                misses++;
+            }
+        return static_cast<float>(misses) / (indices.size() / 3);
+    }
+
+    // fragments shaded per pixel covered, with a depth test, averaged over orthographic views along +x, -x, +y, -y, +z
+    // and -z; both faces of every triangle are drawn, as the scene doesn't cull. 1 means nothing is drawn over.
+    inline float overdraw(const vector<Vertex> &vertices, const vector<unsigned int> &indices)
+    {
+        if (indices.empty())
+            return 0.0f;
+        glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+        for (unsigned int index : indices)
+        {
+            low = glm::min(low, vertices[index].Position);
+            high = glm::max(high, vertices[index].Position);
+        }
+        glm::vec3 extent = high - low;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+        const int R = OVERDRAW_RESOLUTION;
+        vector<float> depth(static_cast<size_t>(R) * R);
+        size_t shaded = 0, covered = 0;
+        for (int axis = 0; axis < 3; axis++)
+            for (int direction = 0; direction < 2; direction++)
+            {
+                std::fill(depth.begin(), depth.end(), FLT_MAX);
+                for (size_t i = 0; i < indices.size(); i += 3)
+                {
+                    // grid coordinates across the view and depth along it, all in [0, 1] of the largest extent
+                    glm::vec3 corner[3];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        glm::vec3 p = (vertices[indices[i + c]].Position - low) * scale;
+                        float z = direction == 0 ? p[axis] : 1.0f - p[axis];
+                        corner[c] = glm::vec3(p[(axis + 1) % 3] * R, p[(axis + 2) % 3] * R, z);
+                    }
+                    float area = (corner[1].x - corner[0].x) * (corner[2].y - corner[0].y) - (corner[2].x - corner[0].x) * (corner[1].y - corner[0].y);
+                    if (area == 0.0f)
+                        continue;
+                    int x0 = std::max(0, static_cast<int>(std::floor(std::min(corner[0].x, std::min(corner[1].x, corner[2].x)))));
+                    int y0 = std::max(0, static_cast<int>(std::floor(std::min(corner[0].y, std::min(corner[1].y, corner[2].y)))));
+                    int x1 = std::min(R - 1, static_cast<int>(std::ceil(std::max(corner[0].x, std::max(corner[1].x, corner[2].x)))));
+                    int y1 = std::min(R - 1, static_cast<int>(std::ceil(std::max(corner[0].y, std::max(corner[1].y, corner[2].y)))));
+                    // pixel centres inside the triangle, edges included; either winding
+                    for (int y = y0; y <= y1; y++)
+                        for (int x = x0; x <= x1; x++)
+                        {
+                            float px = x + 0.5f, py = y + 0.5f;
+                            float w0 = ((corner[2].x - corner[1].x) * (py - corner[1].y) - (corner[2].y - corner[1].y) * (px - corner[1].x)) / area;
+                            float w1 = ((corner[0].x - corner[2].x) * (py - corner[2].y) - (corner[0].y - corner[2].y) * (px - corner[2].x)) / area;
+                            float w2 = 1.0f - w0 - w1;
+                            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                                continue;
+                            float z = w0 * corner[0].z + w1 * corner[1].z + w2 * corner[2].z;
+                            float &stored = depth[static_cast<size_t>(y) * R + x];
+                            if (z < stored)
+                            {
+                                covered += stored == FLT_MAX;
+                                stored = z;
+                                shaded++;
+                            }
+                        }
+                }
+            }
+        return covered > 0 ? static_cast<float>(shaded) / covered : 1.0f;
+    }
+
+    // Tipsify: the triangles of `indices` in vertex cache order
+    inline vector<unsigned int> vertexCacheOrder(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE)
+    {
+        vector<unsigned int> ordered;
+        ordered.reserve(indices.size());
+        if (indices.empty())
+            return ordered;
+
+        // triangles around each vertex: adjacency[first[v] .. first[v + 1]), and how many of them are still to be emitted
+        vector<unsigned int> live(vertexCount, 0), first(vertexCount + 1, 0), adjacency(indices.size());
+        for (unsigned int index : indices)
+            live[index]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            first[v + 1] = first[v] + live[v];
+        vector<unsigned int> fill(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+        vector<unsigned int> cachedAt(vertexCount, 0), deadEnds, candidates;
+        vector<bool> emitted(indices.size() / 3, false);
+        unsigned int time = cacheSize + 1;
+        size_t scan = 0;
+        unsigned int fan = indices[0];
+        for (;;)
+        {
+            // every triangle left around the fanning vertex
+            candidates.clear();
+            for (unsigned int a = first[fan]; a < first[fan + 1]; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                emitted[triangle] = true;
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int v = indices[triangle * 3 + c];
+                    ordered.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cachedAt[v] > cacheSize)
+                        cachedAt[v] = time++;
+                }
+            }
+
+            // the next fan: the vertex just used that will still be cached after its own triangles are emitted (two new
+            // vertices each) and has been cached longest; any live one if none will
+            long best = -1, bestPriority = -1;
+            for (unsigned int v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+                long priority = time - cachedAt[v] + 2 * live[v] <= cacheSize ? time - cachedAt[v] : 0;
+                if (priority > bestPriority)
+                {
+                    best = v;
+                    bestPriority = priority;
+                }
+            }
+            // dead end: the most recently used vertex with triangles left, else the next one in index order
+            while (best < 0 && !deadEnds.empty())
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (live[v] > 0)
+                    best = v;
+            }
+            while (best < 0 && scan < vertexCount)
+            {
+                if (live[scan] > 0)
+                    best = static_cast<long>(scan);
+                scan++;
+            }
+            if (best < 0)
+                break;
+            fan = static_cast<unsigned int>(best);
+        }
+        return ordered;
+    }
+
+    // splits a vertex cache order into clusters (their first triangles) and draws the clusters facing away from the mesh
+    // centre first; the triangles within a cluster keep their order
+    inline vector<unsigned int> overdrawOrder(const vector<unsigned int> &indices, const vector<Vertex> &vertices,
+                                              float threshold = OVERDRAW_THRESHOLD, unsigned int cacheSize = CACHE_SIZE)
+    {
+        size_t triangles = indices.size() / 3;
+        if (triangles == 0)
+            return indices;
+
+        // cache misses of triangle t; advancing the clock by more than the cache size empties the cache
+        vector<unsigned int> cachedAt(vertices.size(), 0);
+        unsigned int time = cacheSize + 1;
+        auto misses = [&](size_t t) {
+            unsigned int count = 0;
+            for (int c = 0; c < 3; c++)
+                if (time - cachedAt[indices[t * 3 + c]] > cacheSize)
+                {
+                    cachedAt[indices[t * 3 + c]] = time++;
+                    count++;
+                }
+            return count;
+        };
+
+        // hard boundaries where nothing was cached
+        vector<size_t> hard;
+        for (size_t t = 0; t < triangles; t++)
+            if (misses(t) == 3)
+                hard.push_back(t);
+        if (hard.empty() || hard[0] != 0)
+            hard.insert(hard.begin(), 0);
+        hard.push_back(triangles);
+
+        // each cut again wherever the ACMR since the last cut, starting with an empty cache, has come down to the threshold
+        // times the whole cluster's: a cluster starting there pays for its own cold cache, wherever it ends up being drawn
+        vector<size_t> clusters;
+        for (size_t h = 0; h + 1 < hard.size(); h++)
+        {
+            size_t start = hard[h], end = hard[h + 1];
+            time += cacheSize + 1;
+            unsigned int clusterMisses = 0;
+            for (size_t t = start; t < end; t++)
+                clusterMisses += misses(t);
+            float limit = threshold * clusterMisses / (end - start);
+
+            clusters.push_back(start);
+            time += cacheSize + 1;
+            unsigned int runningMisses = 0, runningTriangles = 0;
+            for (size_t t = start; t + 1 < end; t++)
+            {
+                runningMisses += misses(t);
+                runningTriangles++;
+                if (runningMisses <= limit * runningTriangles)
+                {
+                    clusters.push_back(t + 1);
+                    time += cacheSize + 1;
+                    runningMisses = runningTriangles = 0;
+                }
+            }
+        }
+        clusters.push_back(triangles);
+
+        // sort key: how far the cluster's area-weighted centre lies along its mean normal, seen from the mesh centre
+        glm::vec3 centre(0.0f);
+        for (unsigned int index : indices)
+            centre += vertices[index].Position;
+        centre /= static_cast<float>(indices.size());
+        size_t clusterCount = clusters.size() - 1;
+        vector<float> facing(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            glm::vec3 weightedCentre(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+            {
+                const glm::vec3 &p0 = vertices[indices[t * 3]].Position, &p1 = vertices[indices[t * 3 + 1]].Position,
+                                &p2 = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+                float triangleArea = glm::length(cross);
+                weightedCentre += (p0 + p1 + p2) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+            float normalLength = glm::length(normal);
+            facing[c] = area > 0.0f && normalLength > 0.0f ? glm::dot(weightedCentre / area - centre, normal / normalLength) : 0.0f;
+        }
+        vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+            order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return facing[a] > facing[b]; });
+
+        vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+            sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+        return sorted;
+    }
+
+    // merges vertices that are identical bit for bit. Assimp's OBJ import and ObjParser emit one vertex per face corner,
+    // so without this no vertex is ever shared and no triangle order can reuse a cached one.
+    inline void weld(MeshCache::CachedMesh &mesh)
+    {
+        const unsigned int EMPTY = ~0u;
+        size_t buckets = 1;
+        while (buckets < mesh.vertices.size() * 2)
+            buckets *= 2;
+        // open addressing on an FNV-1a style hash of the whole vertex, a 32-bit word at a time
+        auto hash = [](const Vertex &vertex) {
+            uint64_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i += sizeof(uint32_t))
+            {
+                uint32_t word;
+                memcpy(&word, reinterpret_cast<const unsigned char *>(&vertex) + i, sizeof(word));
+                h = (h ^ word) * 1099511628211ull;
+            }
+            return h ^ (h >> 32);
+        };
+        static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex is hashed in 32-bit words");
+        vector<unsigned int> table(buckets, EMPTY), remap(mesh.vertices.size());
+        vector<Vertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+        {
+            const Vertex &vertex = mesh.vertices[v];
+            size_t bucket = hash(vertex) & (buckets - 1);
+            while (table[bucket] != EMPTY && memcmp(&vertices[table[bucket]], &vertex, sizeof(Vertex)) != 0)
+                bucket = (bucket + 1) & (buckets - 1);
+            if (table[bucket] == EMPTY)
+            {
+                table[bucket] = static_cast<unsigned int>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            remap[v] = table[bucket];
+        }
+        for (unsigned int &index : mesh.indices)
+            index = remap[index];
+        mesh.vertices.swap(vertices);
+    }
+
+    // renumbers the vertices in order of first use, dropping any the indices never reference
+    inline void vertexFetchOrder(MeshCache::CachedMesh &mesh)
+    {
+        const unsigned int UNUSED = ~0u;
+        vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+        vector<Vertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices)
+        {
+            if (remap[index] == UNUSED)
+            {
+                remap[index] = static_cast<unsigned int>(vertices.size());
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices.swap(vertices);
+    }
+
+    // all passes on one mesh
+    inline void optimize(MeshCache::CachedMesh &mesh)
+    {
+        if (mesh.indices.size() < 3)
+            return;
+        weld(mesh);
+        mesh.indices = overdrawOrder(vertexCacheOrder(mesh.indices, mesh.vertices.size()), mesh.vertices);
+        vertexFetchOrder(mesh);
+    }
+
+    // every mesh of a model, in parallel on the shared pool
+    inline void optimize(vector<MeshCache::CachedMesh> &meshes)
+    {
+        if (meshes.empty())
+            return;
+        ThreadPool &pool = ThreadPool::shared();
+        vector<future<void>> optimized;
+        for (size_t i = 1; i < meshes.size(); i++)
+        {
+            MeshCache::CachedMesh *mesh = &meshes[i];
+            optimized.push_back(pool.submit([mesh] { optimize(*mesh); }));
+        }
+        optimize(meshes[0]);
+        for (future<void> &mesh : optimized)
+            pool.wait(mesh);
+    }
+}
+#endif
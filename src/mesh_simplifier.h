@@ -0,0 +1,379 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh_cache.h>
+#include <mesh_optimizer.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <vector>
+
+using namespace std;
+
+// Builds the levels of detail of imported meshes, once at import so the mesh cache stores them. Each level is made from
+// the previous one by collapsing edges (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997):
+// every position keeps the sum of the squared distances to the planes of the triangles around it, and the edges whose
+// collapse moves the surface least go first. Collapses are half-edge, moving one end onto the other, so the levels only
+// need new indices and share the mesh's vertex buffer. Positions on a border or a texture/normal seam never move, which
+// keeps outlines and UV charts intact at the price of simplifying less there.
+namespace MeshSimplifier
+{
+    // levels after the full mesh, each aiming at half the triangles of the one before
+    const size_t MAX_LODS = 4;
+    // no level with fewer triangles than this; below it a mesh is too cheap for another level to matter
+    const size_t MIN_TRIANGLES = 32;
+    // a level keeping more than this share of the previous level's triangles (everything left is locked) is not worth its
+    // indices, and ends the chain
+    const float MIN_REDUCTION = 0.85f;
+    // largest error a level may have, relative to the mesh's bounding radius
+    const float MAX_ERROR = 0.25f;
+
+    // symmetric 4x4 matrix of the plane quadric, its 10 distinct coefficients
+    struct Quadric {
+        float a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    };
+
+    inline Quadric planeQuadric(const glm::vec3 &normal, float d)
+    {
+        return { normal.x * normal.x, normal.x * normal.y, normal.x * normal.z, normal.x * d,
+                 normal.y * normal.y, normal.y * normal.z, normal.y * d,
+                 normal.z * normal.z, normal.z * d,
+                 d * d };
+    }
+
+    inline void add(Quadric &q, const Quadric &r)
+    {
+        q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad; q.b2 += r.b2;
+        q.bc += r.bc; q.bd += r.bd; q.c2 += r.c2; q.cd += r.cd; q.d2 += r.d2;
+    }
+
+    // sum of the squared distances from p to the quadric's planes
+    inline float evaluate(const Quadric &q, const glm::vec3 &p)
+    {
+        float value = q.a2 * p.x * p.x + q.b2 * p.y * p.y + q.c2 * p.z * p.z + q.d2
+                      + 2.0f * (q.ab * p.x * p.y + q.ac * p.x * p.z + q.bc * p.y * p.z + q.ad * p.x + q.bd * p.y + q.cd * p.z);
+        return std::max(value, 0.0f);
+    }
+
+    // ids of the distinct values of the first `bytes` bytes of every vertex, in order of first appearance; `first` gets
+    // the first vertex with each id
+    inline vector<unsigned int> classify(const vector<Vertex> &vertices, size_t bytes, vector<unsigned int> &first)
+    {
+        const unsigned int EMPTY = ~0u;
+        size_t buckets = 1;
+        while (buckets < vertices.size() * 2)
+            buckets *= 2;
+        auto hash = [bytes](const Vertex &vertex) {
+            uint64_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < bytes; i += sizeof(uint32_t))
+            {
+                uint32_t word;
+                memcpy(&word, reinterpret_cast<const unsigned char *>(&vertex) + i, sizeof(word));
+                h = (h ^ word) * 1099511628211ull;
+            }
+            return h ^ (h >> 32);
+        };
+        vector<unsigned int> table(buckets, EMPTY), ids(vertices.size());
+        first.clear();
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            size_t bucket = hash(vertices[v]) & (buckets - 1);
+            while (table[bucket] != EMPTY && memcmp(&vertices[first[table[bucket]]], &vertices[v], bytes) != 0)
+                bucket = (bucket + 1) & (buckets - 1);
+            if (table[bucket] == EMPTY)
+            {
+                table[bucket] = static_cast<unsigned int>(first.size());
+                first.push_back(static_cast<unsigned int>(v));
+            }
+            ids[v] = table[bucket];
+        }
+        return ids;
+    }
+
+    // the state carried from one level to the next
+    class Simplifier {
+    public:
+        // current triangles, as vertex indices
+        vector<unsigned int> indices;
+        // largest collapse error so far, in model units
+        float error;
+
+        Simplifier(const vector<Vertex> &vertices, const vector<unsigned int> &source) : error(0.0f)
+        {
+            vector<unsigned int> firstVertex, firstWedge;
+            position = classify(vertices, sizeof(glm::vec3), firstVertex);
+            // a wedge is a distinct position, normal and texture coordinate; the tangent frame is rebuilt by the shader
+            // well enough when a level swaps one for another
+            vector<unsigned int> wedge = classify(vertices, offsetof(Vertex, Tangent), firstWedge);
+            static_assert(offsetof(Vertex, Tangent) % sizeof(uint32_t) == 0, "Vertex is hashed in 32-bit words");
+            points.resize(firstVertex.size());
+            for (size_t p = 0; p < points.size(); p++)
+                points[p] = vertices[firstVertex[p]].Position;
+
+            // every corner points at its wedge's first vertex, so a position without a seam has a single vertex
+            indices.reserve(source.size());
+            for (unsigned int index : source)
+                indices.push_back(firstWedge[wedge[index]]);
+            removeDegenerate();
+
+            // positions with several wedges are on a seam
+            locked.assign(points.size(), 0);
+            vector<unsigned int> wedgeOf(points.size(), ~0u);
+            for (unsigned int v : firstWedge)
+            {
+                unsigned int p = position[v];
+                if (wedgeOf[p] != ~0u && wedgeOf[p] != v)
+                    locked[p] = 1;
+                wedgeOf[p] = v;
+            }
+            // and positions on an edge not shared by exactly two triangles are on a border (or a non-manifold fan)
+            vector<uint64_t> edges;
+            edges.reserve(indices.size());
+            for (size_t i = 0; i < indices.size(); i += 3)
+                for (int e = 0; e < 3; e++)
+                {
+                    uint64_t a = position[indices[i + e]], b = position[indices[i + (e + 1) % 3]];
+                    edges.push_back(a < b ? a << 32 | b : b << 32 | a);
+                }
+            sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();)
+            {
+                size_t j = i;
+                while (j < edges.size() && edges[j] == edges[i])
+                    j++;
+                if (j - i != 2)
+                    locked[edges[i] >> 32] = locked[edges[i] & 0xffffffffu] = 1;
+                i = j;
+            }
+
+            quadrics.assign(points.size(), Quadric());
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                const glm::vec3 &p0 = points[position[indices[i]]], &p1 = points[position[indices[i + 1]]], &p2 = points[position[indices[i + 2]]];
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float length = glm::length(normal);
+                if (length <= 0.0f)
+                    continue;
+                normal /= length;
+                Quadric plane = planeQuadric(normal, -glm::dot(normal, p0));
+                for (int c = 0; c < 3; c++)
+                    add(quadrics[position[indices[i + c]]], plane);
+            }
+        }
+
+        // collapses edges until at most `targetTriangles` are left, no collapse is possible, or the next one would move
+        // the surface more than `maxError`
+        void simplify(size_t targetTriangles, float maxError)
+        {
+            float maxCost = maxError * maxError;
+            while (indices.size() / 3 > targetTriangles)
+                if (!pass(targetTriangles, maxCost))
+                    break;
+        }
+
+    private:
+        vector<unsigned int> position;
+        vector<glm::vec3> points;
+        vector<Quadric> quadrics;
+        vector<unsigned char> locked;
+        // triangles around each position, CSR
+        vector<unsigned int> firstTriangle, triangles;
+
+        struct Collapse {
+            float cost;
+            unsigned int from, to;
+            bool operator<(const Collapse &other) const { return cost < other.cost; }
+        };
+
+        void buildAdjacency()
+        {
+            firstTriangle.assign(points.size() + 1, 0);
+            for (unsigned int index : indices)
+                firstTriangle[position[index] + 1]++;
+            for (size_t p = 0; p < points.size(); p++)
+                firstTriangle[p + 1] += firstTriangle[p];
+            triangles.resize(indices.size());
+            vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                triangles[fill[position[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        // one round of independent collapses, cheapest first; returns false if none could be made
+        bool pass(size_t targetTriangles, float maxCost)
+        {
+            buildAdjacency();
+            // the cheapest edge out of every position that may move
+            vector<Collapse> candidates;
+            for (unsigned int a = 0; a < points.size(); a++)
+            {
+                if (locked[a] || firstTriangle[a] == firstTriangle[a + 1])
+                    continue;
+                Collapse best = { FLT_MAX, a, a };
+                for (unsigned int t = firstTriangle[a]; t < firstTriangle[a + 1]; t++)
+                    for (int c = 0; c < 3; c++)
+                    {
+                        unsigned int b = position[indices[triangles[t] * 3 + c]];
+                        if (b == a)
+                            continue;
+                        Quadric q = quadrics[a];
+                        add(q, quadrics[b]);
+                        float cost = evaluate(q, points[b]);
+                        if (cost < best.cost)
+                            best = { cost, a, b };
+                    }
+                if (best.cost <= maxCost)
+                    candidates.push_back(best);
+            }
+            sort(candidates.begin(), candidates.end());
+
+            // a position touched by a collapse this round keeps its triangles until the next, so every check below sees
+            // the triangles as they will be
+            vector<unsigned char> touched(points.size(), 0);
+            vector<unsigned int> remap(indices.size() ? *max_element(indices.begin(), indices.end()) + 1 : 0);
+            for (size_t v = 0; v < remap.size(); v++)
+                remap[v] = static_cast<unsigned int>(v);
+            vector<unsigned int> mark(points.size(), ~0u);
+            size_t triangleCount = indices.size() / 3;
+            bool collapsed = false;
+            for (const Collapse &collapse : candidates)
+            {
+                if (triangleCount <= targetTriangles)
+                    break;
+                unsigned int a = collapse.from, b = collapse.to;
+                if (touched[a] || touched[b])
+                    continue;
+                // link condition: a and b share exactly the two neighbours opposite their edge, else the collapse
+                // pinches the surface
+                for (unsigned int t = firstTriangle[a]; t < firstTriangle[a + 1]; t++)
+                    for (int c = 0; c < 3; c++)
+                        mark[position[indices[triangles[t] * 3 + c]]] = a;
+                size_t shared = 0;
+                for (unsigned int t = firstTriangle[b]; t < firstTriangle[b + 1]; t++)
+                    for (int c = 0; c < 3; c++)
+                    {
+                        unsigned int p = position[indices[triangles[t] * 3 + c]];
+                        if (p != a && p != b && mark[p] == a)
+                        {
+                            mark[p] = ~0u;
+                            shared++;
+                        }
+                    }
+                if (shared != 2)
+                    continue;
+                // the triangles that stay must not fold over, and b must have one vertex on both triangles of the edge
+                unsigned int target = ~0u, source = ~0u;
+                bool valid = true;
+                for (unsigned int t = firstTriangle[a]; t < firstTriangle[a + 1] && valid; t++)
+                {
+                    const unsigned int *corner = &indices[triangles[t] * 3];
+                    int at = 0, bt = -1;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        if (position[corner[c]] == a)
+                            at = c;
+                        if (position[corner[c]] == b)
+                            bt = c;
+                    }
+                    source = corner[at];
+                    if (bt >= 0)
+                    {
+                        valid = target == ~0u || target == corner[bt];
+                        target = corner[bt];
+                        continue;
+                    }
+                    const glm::vec3 &p1 = points[position[corner[(at + 1) % 3]]], &p2 = points[position[corner[(at + 2) % 3]]];
+                    glm::vec3 before = glm::cross(p1 - points[a], p2 - points[a]);
+                    glm::vec3 after = glm::cross(p1 - points[b], p2 - points[b]);
+                    valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+                }
+                if (!valid || target == ~0u)
+                    continue;
+
+                remap[source] = target;
+                add(quadrics[b], quadrics[a]);
+                error = std::max(error, std::sqrt(collapse.cost));
+                for (unsigned int t = firstTriangle[a]; t < firstTriangle[a + 1]; t++)
+                    for (int c = 0; c < 3; c++)
+                        touched[position[indices[triangles[t] * 3 + c]]] = 1;
+                triangleCount -= 2;
+                collapsed = true;
+            }
+            if (!collapsed)
+                return false;
+            for (unsigned int &index : indices)
+                index = remap[index];
+            removeDegenerate();
+            return true;
+        }
+
+        // drops the triangles with two corners at the same position
+        void removeDegenerate()
+        {
+            size_t kept = 0;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                unsigned int a = position[indices[i]], b = position[indices[i + 1]], c = position[indices[i + 2]];
+                if (a == b || b == c || c == a)
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    indices[kept + k] = indices[i + k];
+                kept += 3;
+            }
+            indices.resize(kept);
+        }
+    };
+
+    // the levels of detail of one mesh, each in vertex cache order; none for skinned meshes, whose bones move vertices
+    // the error was never measured for
+    inline void buildLods(MeshCache::CachedMesh &mesh)
+    {
+        mesh.lods.clear();
+        if (mesh.skinned || mesh.indices.size() / 3 < MIN_TRIANGLES * 2)
+            return;
+        Aabb box;
+        BoundingSphere sphere;
+        computeBounds(&mesh.vertices[0].Position, mesh.vertices.size(), sizeof(Vertex), box, sphere);
+        float maxError = sphere.radius * MAX_ERROR;
+
+        Simplifier simplifier(mesh.vertices, mesh.indices);
+        size_t previous = mesh.indices.size() / 3;
+        while (mesh.lods.size() < MAX_LODS && previous / 2 >= MIN_TRIANGLES)
+        {
+            simplifier.simplify(previous / 2, maxError);
+            size_t triangles = simplifier.indices.size() / 3;
+            if (triangles > previous * MIN_REDUCTION)
+                break;
+            MeshLod lod;
+            lod.indices = MeshOptimizer::vertexCacheOrder(simplifier.indices, mesh.vertices.size());
+            lod.error = simplifier.error;
+            mesh.lods.push_back(std::move(lod));
+            previous = triangles;
+        }
+    }
+
+    // every mesh of a model, in parallel on the shared pool
+    inline void buildLods(vector<MeshCache::CachedMesh> &meshes)
+    {
+        if (meshes.empty())
+            return;
+        ThreadPool &pool = ThreadPool::shared();
+        vector<future<void>> built;
+        for (size_t i = 1; i < meshes.size(); i++)
+        {
+            MeshCache::CachedMesh *mesh = &meshes[i];
+            built.push_back(pool.submit([mesh] { buildLods(*mesh); }));
+        }
+        buildLods(meshes[0]);
+        for (future<void> &mesh : built)
+            pool.wait(mesh);
+    }
+}
+#endif
@@ -10,23 +10,59 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <dds.h>
 #include <mesh.h>
+#include <mesh_cache.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
+#include <obj_parser.h>
+#include <texture_cache.h>
 #include <shader.h>
+#include <thread_pool.h>
+#include <vertex_convert.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <functional>
+#include <future>
 #include <map>
 #include <vector>
+#include <sys/stat.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 using namespace std;
 
+// post-processing applied to every imported model; part of the mesh cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Assimp's vertex arrays are read as float triples");
+
+DecodedImage DecodeImage(const char *path, const string &directory);
+void FreeImage(DecodedImage &image);
+unsigned int UploadTexture(DecodedImage &image, const char *path, GLuint unpackBuffer = 0);
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// What reading a model produces before anything touches OpenGL: the final vertices and indices of its meshes and the
+// textures they use. Model::read builds it and is safe to run on any thread; a Model is then made from it on the GL
+// thread, at once or a piece at a time (see model_loader.h).
+struct ModelSource {
+    string directory;
+    // the requested layout, or VERTEX_FULL if any mesh is skinned
+    VertexLayout layout;
+    bool fromCache;
+    vector<MeshCache::CachedMesh> meshes;
+    // every texture the meshes use, once, in order of first use (paths relative to the directory)
+    vector<string> texturePaths;
+};
+
 class Model
 {
 public:
@@ -35,42 +71,307 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool loadedFromCache;
+    // GPU vertex layout of the meshes: the requested one, unless the model has skinned meshes which need the full layout.
+    // Programs drawing the model must be compiled with vertexDefines().
+    VertexLayout vertexLayout;
+    // whether the meshes keep their vertices and indices on the CPU after upload (for physics or picking); by default
+    // only the GPU copy remains
+    bool keepGeometry;
+
+    // constructor, expects a filepath to a 3D model. With useCache the binary mesh cache is tried before Assimp.
+    Model(string const &path, bool gamma = false, bool useCache = true, VertexLayout layout = VERTEX_COMPACT, bool keepGeometry = false)
+        : gammaCorrection(gamma), loadedFromCache(false), vertexLayout(layout), keepGeometry(keepGeometry)
+    {
+        // images another model already loaded are shared, the others are decoded on the thread pool while the meshes are
+        // still being read
+        vector<future<DecodedImage>> images;
+        vector<GLuint> shared;
+        string dir = path.substr(0, path.find_last_of('/'));
+        ModelSource source;
+        read(path, useCache, layout, source, [&images, &shared, dir](const string &file) {
+            GLuint texture = TextureCache::shared().acquire(dir + '/' + file);
+            shared.push_back(texture);
+            images.push_back(texture != 0 ? future<DecodedImage>()
+                                          : ThreadPool::shared().submit([file, dir] { return DecodeImage(file.c_str(), dir); }));
+        });
+        init(source);
+        for (MeshCache::CachedMesh &mesh : source.meshes)
+            addMesh(std::move(mesh));
+        // waits for the decodes, which run in parallel so this costs about as long as the slowest image
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            if (shared[i] != 0)
+            {
+                setTexture(source.texturePaths[i], shared[i]);
+                continue;
+            }
+            DecodedImage image = images[i].get();
+            setTexture(source.texturePaths[i], shareTexture(dir + '/' + source.texturePaths[i], image));
+        }
+    }
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // a model without meshes yet, to be filled from `source` with addMesh and setTexture; its textures start as
+    // `placeholder`
+    explicit Model(const ModelSource &source, GLuint placeholder = 0, bool keepGeometry = false)
+        : gammaCorrection(false), keepGeometry(keepGeometry)
     {
-        loadModel(path);
+        init(source, placeholder);
     }
 
-    // draws the model, and thus all its meshes
+    // preprocessor definitions selecting the model's vertex layout in models/common/vertexFormat.glsl
+    string vertexDefines() const
+    {
+        return vertexDefines(vertexLayout);
+    }
+    static string vertexDefines(VertexLayout layout)
+    {
+        return layout == VERTEX_COMPACT ? "#define COMPACT_VERTEX\n" : "";
+    }
+
+    // bytes of vertex data the meshes keep on the GPU
+    size_t vertexBufferSize() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.vertexBufferSize();
+        return bytes;
+    }
+
+    // the meshes share the model's GPU memory ranges, so models are not copied
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    ~Model()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.release();
+        for (const Texture &texture : textures_loaded)
+            TextureCache::shared().release(texture.id);
+    }
+
+    // draws the model, and thus all its meshes; all of them live in the arena of the model's layout, bound once
     void Draw(Shader &shader)
     {
+        if (meshes.empty())
+            return;
+        meshes[0].arena().bind();
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].DrawBound(shader);
     }
 
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // draws every instance of the buffer, one instanced draw call per mesh, each mesh at the level of detail for
+    // `pixelsPerUnit` pixels on screen per model unit (see Mesh::lodFor; the default draws the full meshes)
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances, float pixelsPerUnit = FLT_MAX)
+    {
+        if (instances.count == 0 || meshes.empty())
+            return;
+        meshes[0].arena().bind();
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstancedBound(shader, instances, meshes[i].lodFor(pixelsPerUnit));
+    }
+
+    // triangles of one instance at the levels DrawInstanced picks for `pixelsPerUnit`
+    size_t triangleCount(float pixelsPerUnit = FLT_MAX) const
+    {
+        size_t triangles = 0;
+        for (const Mesh &mesh : meshes)
+            triangles += mesh.lodRange(mesh.lodFor(pixelsPerUnit)).indexCount / 3;
+        return triangles;
+    }
+
+    // reads a model with supported ASSIMP extensions from file, or from its mesh cache, into `source` without touching
+    // OpenGL; a fresh import refreshes the cache. `textureFound` is called for each texture as soon as it is seen, so
+    // its decoding can start early. Returns false (and leaves no meshes) when the file can't be imported.
+    static bool read(const string &path, bool useCache, VertexLayout layout, ModelSource &source,
+                     const function<void(const string &)> &textureFound = nullptr)
+    {
+        // warm start: the cache already holds the final vertex data, only the textures still have to be loaded
+        if (useCache && MeshCache::load(path, cacheFlags(path), source.meshes))
+        {
+            source.directory = path.substr(0, path.find_last_of('/'));
+            source.fromCache = true;
+            source.texturePaths.clear();
+            source.layout = layout;
+            addMeshTextures(source, textureFound);
+            return true;
+        }
+
+        if (!import(path, layout, source, textureFound))
+            return false;
+        if (!MeshCache::store(path, cacheFlags(path), source.meshes))
+            cout << "WARNING::MESH_CACHE:: could not write cache for " << path << endl;
+        return true;
+    }
+
+    // reads a model from its file, skipping the mesh cache: .obj files in the subset ObjParser handles through it (unless
+    // disabled), everything else through ASSIMP; the meshes are then reordered by MeshOptimizer (unless disabled) and
+    // given their levels of detail by MeshSimplifier, unless `process` is false (to time the importers alone)
+    static bool import(const string &path, VertexLayout layout, ModelSource &source, const function<void(const string &)> &textureFound = nullptr,
+                       bool process = true)
     {
+        // retrieve the directory path of the filepath
+        source.directory = path.substr(0, path.find_last_of('/'));
+        source.layout = layout;
+        source.fromCache = false;
+        source.meshes.clear();
+        source.texturePaths.clear();
+
+        if (parsesObj(path) && ObjParser::read(path, source.meshes))
+        {
+            addMeshTextures(source, textureFound);
+            if (process)
+                processMeshes(source.meshes);
+            return true;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+
+        // one layout for the whole model, so a single program variant draws all of its meshes
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+            if (scene->mMeshes[i]->HasBones())
+                source.layout = VERTEX_FULL;
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, source, textureFound);
+        if (process)
+            processMeshes(source.meshes);
+        return true;
+    }
+
+    // uploads a mesh read into the model's source, taking over its vertices and indices; its textures are whatever
+    // setTexture last gave their paths
+    void addMesh(MeshCache::CachedMesh &&mesh)
+    {
+        vector<Texture> textures;
+        for (const MeshCache::TextureRef &ref : mesh.textures)
+        {
+            Texture texture;
+            texture.id = 0;
+            texture.type = ref.type;
+            texture.path = ref.path;
+            for (const Texture &loaded : textures_loaded)
+                if (loaded.path == ref.path)
+                {
+                    texture.id = loaded.id;
+                    break;
+                }
+            textures.push_back(texture);
+        }
+        meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures), vertexLayout, mesh.skinned, keepGeometry,
+                            std::move(mesh.lods));
+    }
+
+    // the texture of a freshly decoded image file: one already holding the same pixels if there is one, else a new
+    // upload (staged through `unpackBuffer` if given); either way a reference the model releases when destroyed
+    static GLuint shareTexture(const string &file, DecodedImage &image, GLuint unpackBuffer = 0)
+    {
+        TextureCache &cache = TextureCache::shared();
+        GLuint texture = cache.acquire(file, image, FreeImage);
+        if (texture == 0)
+        {
+            texture = UploadTexture(image, file.c_str(), unpackBuffer);
+            cache.add(file, image, texture);
+        }
+        return texture;
+    }
+
+    // gives every mesh using the texture at `path` the GL texture `id`
+    void setTexture(const string &path, GLuint id)
+    {
+        for (Texture &loaded : textures_loaded)
+            if (loaded.path == path)
+                loaded.id = id;
+        for (Mesh &mesh : meshes)
+            for (Texture &texture : mesh.textures)
+                if (texture.path == path)
+                    texture.id = id;
+    }
+
+    // drops the model's texture references once their contents live elsewhere (StaticScene copies them into its texture
+    // arrays); the textures are freed unless other models share them, and the meshes are left untextured
+    void releaseTextures()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureCache::shared().release(texture.id);
+        textures_loaded.clear();
+        for (Mesh &mesh : meshes)
+            mesh.textures.clear();
+    }
+
+private:
+    void init(const ModelSource &source, GLuint placeholder = 0)
+    {
+        directory = source.directory;
+        vertexLayout = source.layout;
+        loadedFromCache = source.fromCache;
+        meshes.reserve(source.meshes.size());
+        for (const string &path : source.texturePaths)
+        {
+            Texture texture;
+            texture.id = placeholder;
+            texture.path = path;
+            textures_loaded.push_back(texture);
+        }
+    }
+
+    // whether import() tries ObjParser on the file before Assimp
+    static bool parsesObj(const string &path)
+    {
+        string extension = path.substr(std::min(path.size(), path.find_last_of('.') + 1));
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+        return ObjParser::enabled() && extension == "obj";
+    }
+
+    // the mesh cache key: the import flags, plus Assimp's cache locality bit for meshes MeshOptimizer reordered (it does
+    // that job and more, Assimp's step itself is never run), so turning the optimizer off doesn't load reordered meshes,
+    // and its (never requested) bounding box bit for files ObjParser gets first, so each importer has its own caches
+    static unsigned int cacheFlags(const string &path)
+    {
+        return MODEL_IMPORT_FLAGS | (MeshOptimizer::enabled() ? static_cast<unsigned int>(aiProcess_ImproveCacheLocality) : 0u)
+               | (parsesObj(path) ? static_cast<unsigned int>(aiProcess_GenBoundingBoxes) : 0u);
+    }
+
+    // the passes run on freshly imported meshes, whichever importer read them
+    static void processMeshes(vector<MeshCache::CachedMesh> &meshes)
+    {
+        if (MeshOptimizer::enabled())
+            MeshOptimizer::optimize(meshes);
+        MeshSimplifier::buildLods(meshes);
+    }
+
+    // the layout and textures of meshes read without Assimp (from the cache or ObjParser)
+    static void addMeshTextures(ModelSource &source, const function<void(const string &)> &textureFound)
+    {
+        for (const MeshCache::CachedMesh &mesh : source.meshes)
+        {
+            if (mesh.skinned)
+                source.layout = VERTEX_FULL;
+            for (const MeshCache::TextureRef &ref : mesh.textures)
+                addTexturePath(source, ref.path, textureFound);
+        }
+    }
+
+    // records a texture the first time a mesh uses it
+    static void addTexturePath(ModelSource &source, const string &path, const function<void(const string &)> &textureFound)
+    {
+        if (std::find(source.texturePaths.begin(), source.texturePaths.end(), path) != source.texturePaths.end())
+            return;
+        source.texturePaths.push_back(path);
+        if (textureFound)
+            textureFound(path);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelSource &source, const function<void(const string &)> &textureFound)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -78,73 +379,52 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            source.meshes.push_back(processMesh(mesh, scene, source, textureFound));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, source, textureFound);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshCache::CachedMesh processMesh(aiMesh *mesh, const aiScene *scene, ModelSource &source,
+                                             const function<void(const string &)> &textureFound)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
+        vector<MeshCache::TextureRef> textures;
 
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        // written in place into vectors sized up front; they are moved from here into the Mesh, never copied. The
+        // attributes are copied stream by stream (see vertex_convert.h); a mesh without texture coordinates has no
+        // tangent frame either.
+        vertices.resize(mesh->mNumVertices);
+        if (mesh->mNumVertices > 0)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
-            }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
+            bool hasTexCoords = mesh->mTextureCoords[0] != nullptr;
+            VertexConvert::AttributeStreams streams = {
+                &mesh->mVertices[0].x,
+                mesh->HasNormals() ? &mesh->mNormals[0].x : nullptr,
+                hasTexCoords ? &mesh->mTextureCoords[0][0].x : nullptr,
+                hasTexCoords && mesh->mTangents ? &mesh->mTangents[0].x : nullptr,
+                hasTexCoords && mesh->mBitangents ? &mesh->mBitangents[0].x : nullptr,
+                mesh->mNumVertices
+            };
+            VertexConvert::interleave(streams, vertices.data());
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        size_t indexCount = 0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+        indices.resize(indexCount);
+        unsigned int *index = indices.data();
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            index = std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
@@ -156,94 +436,202 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures, source, textureFound);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures, source, textureFound);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures, source, textureFound);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures, source, textureFound);
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the mesh data extracted
+        MeshCache::CachedMesh result;
+        result.vertices.swap(vertices);
+        result.indices.swap(indices);
+        result.textures.swap(textures);
+        result.skinned = mesh->HasBones();
+        return result;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends the material's textures of a given type to `textures`, recording the ones not seen before in the source
+    static void loadMaterialTextures(aiMaterial *mat, aiTextureType type, const string &typeName, vector<MeshCache::TextureRef> &textures,
+                                     ModelSource &source, const function<void(const string &)> &textureFound)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            MeshCache::TextureRef texture = { typeName, str.C_Str() };
+            textures.push_back(texture);
+            addTexturePath(source, texture.path, textureFound);
         }
-        return textures;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// the modification time of a file, or 0 if it can't be read
+static time_t ModificationTime(const string &path)
+{
+    struct stat status;
+    return stat(path.c_str(), &status) == 0 ? status.st_mtime : 0;
+}
+
+// the block-compressed version of an image file written by tools/texture_convert.cpp, if there is one at least as new
+// as the image; data stays null otherwise
+static DecodedImage ReadCompressedImage(const string &filename)
+{
+    DecodedImage image = {};
+    string ddsPath = Dds::pathFor(filename);
+    time_t compressedTime = ModificationTime(ddsPath);
+    if (compressedTime == 0)
+        return image;
+    if (compressedTime < ModificationTime(filename))
+    {
+        std::cout << "texture: " << ddsPath << " is older than " << filename << ", decoding the image" << std::endl;
+        return image;
+    }
+    Dds::Image dds = {};
+    if (!Dds::read(ddsPath, dds))
+    {
+        std::cout << "ERROR::TEXTURE::DDS_NOT_READ: " << ddsPath << std::endl;
+        return image;
+    }
+    image.data = dds.data;
+    image.width = static_cast<int>(dds.width);
+    image.height = static_cast<int>(dds.height);
+    image.levels = static_cast<int>(dds.levels);
+    image.size = dds.size;
+    switch (dds.format)
+    {
+    case Dds::BC1:
+        image.compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        image.nrComponents = 3;
+        break;
+    case Dds::BC3:
+        image.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        image.nrComponents = 4;
+        break;
+    case Dds::BC5:
+        image.compressedFormat = GL_COMPRESSED_RG_RGTC2;
+        image.nrComponents = 2;
+        break;
+    default:
+        std::cout << "ERROR::TEXTURE::DDS_FORMAT_UNKNOWN: " << ddsPath << std::endl;
+        free(dds.data);
+        return DecodedImage();
+    }
+    return image;
+}
+
+// decodes an image file, or reads its compressed version instead when there is one (see Dds::enabled()); safe to call
+// from any thread
+DecodedImage DecodeImage(const char *path, const string &directory)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    DecodedImage image = {};
+    if (Dds::enabled())
+        image = ReadCompressedImage(filename);
+    if (!image.data)
+        image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+    image.hash = image.data ? TextureCache::contentHash(image) : 0;
+    return image;
+}
+
+// frees what DecodeImage allocated, by whichever reader allocated it
+void FreeImage(DecodedImage &image)
+{
+    if (image.compressedFormat != 0)
+        free(image.data);
+    else if (image.data)
+        stbi_image_free(image.data);
+    image.data = NULL;
+}
+
+// creates a GL texture from a decoded image and frees the pixels; must run on the thread owning the GL context. With an
+// unpack buffer the pixels are staged in it (orphaned first, so an earlier upload from it isn't waited for) and the
+// driver copies them to the texture asynchronously. Compressed images are uploaded level by level as they are; the
+// others get their mipmaps generated.
+unsigned int UploadTexture(DecodedImage &image, const char *path, GLuint unpackBuffer)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.data)
     {
-        GLenum format;
-        if (nrComponents == 1)
+        GLenum format = GL_RGBA;
+        if (image.nrComponents == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.nrComponents == 2)
+            format = GL_RG;
+        else if (image.nrComponents == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        GLState::current().bindTexture(0, GL_TEXTURE_2D, textureID);
+        // where the data starts: client memory, or offset 0 in the unpack buffer
+        const unsigned char *pixels = image.data;
+        bool staged = false;
+        if (unpackBuffer != 0)
+        {
+            GLsizeiptr size = static_cast<GLsizeiptr>(image.bytes());
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+            void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (staging)
+            {
+                memcpy(staging, image.data, static_cast<size_t>(size));
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                pixels = NULL;
+                staged = true;
+            }
+            else
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (image.compressedFormat != 0)
+        {
+            size_t blockBytes = image.compressedFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16, offset = 0;
+            GLsizei width = image.width, height = image.height;
+            for (int level = 0; level < image.levels; level++)
+            {
+                size_t size = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+                const void *data = staged ? reinterpret_cast<const void *>(offset) : pixels + offset;
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, image.compressedFormat, width, height, 0, static_cast<GLsizei>(size), data);
+                offset += size;
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            // a chain cut short by the converter is sampled only as far as it goes
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+        }
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        if (unpackBuffer != 0)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (image.compressedFormat == 0)
+            glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
+        FreeImage(image);
     }
     else
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
+    image.data = NULL;
 
     return textureID;
 }
+
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    DecodedImage image = DecodeImage(path, directory);
+    return UploadTexture(image, path);
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "model.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Loads models without blocking the render loop. load() returns a handle at once and reads the model (Assimp or the
+// mesh cache) on the thread pool; the images are then decoded on the pool too. update(), called once per frame on the
+// GL thread, uploads what is ready within a byte budget, so a large model is spread over several frames instead of
+// stalling one: meshes go into the geometry arena, images are staged through a pixel unpack buffer. A model becomes
+// available once all its meshes are uploaded; textures still being decoded are drawn with a grey placeholder until
+// theirs arrives.
+class ModelLoader
+{
+public:
+    typedef size_t Handle;
+
+    // bytes of vertices, indices and pixels uploaded per update(); the first upload of a frame always goes through, so a
+    // single item larger than the budget still makes progress
+    size_t uploadBudget;
+
+    explicit ModelLoader(size_t uploadBudget = 8u << 20) : uploadBudget(uploadBudget), placeholder(0), unpackBuffer(0)
+    {
+        // mid grey, so untextured-looking geometry is still lit while its texture loads
+        const unsigned char grey[4] = { 128, 128, 128, 255 };
+        glGenTextures(1, &placeholder);
+        GLState::current().bindTexture(0, GL_TEXTURE_2D, placeholder);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenBuffers(1, &unpackBuffer);
+    }
+
+    ~ModelLoader()
+    {
+        // reads still running on the pool only fill their own ModelSource; wait for them so none outlives the loader
+        for (unique_ptr<Entry> &entry : entries)
+        {
+            if (entry->source.valid())
+                entry->source.wait();
+            for (future<DecodedImage> &image : entry->images)
+                if (image.valid())
+                    freeImage(image.get());
+            if (entry->heldImage != Entry::NO_IMAGE)
+                freeImage(entry->held);
+        }
+        entries.clear();
+        GLState::current().forgetTexture(placeholder);
+        glDeleteTextures(1, &placeholder);
+        glDeleteBuffers(1, &unpackBuffer);
+    }
+
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+
+    // starts loading a model; nothing is uploaded before the next update(). keepGeometry is passed on to the Model.
+    Handle load(const string &path, VertexLayout layout = VERTEX_COMPACT, bool keepGeometry = false)
+    {
+        unique_ptr<Entry> entry(new Entry());
+        entry->keepGeometry = keepGeometry;
+        entry->source = ThreadPool::shared().submit([path, layout] {
+            ModelSource source;
+            Model::read(path, true, layout, source);
+            return source;
+        });
+        entries.push_back(std::move(entry));
+        return entries.size() - 1;
+    }
+
+    // uploads within the budget; returns whether anything was uploaded
+    bool update()
+    {
+        size_t budget = uploadBudget;
+        bool first = true;
+        // the first upload of the frame goes through whatever its size
+        auto fits = [&](size_t bytes) {
+            if (!first && bytes > budget)
+                return false;
+            budget -= std::min(bytes, budget);
+            first = false;
+            return true;
+        };
+
+        for (unique_ptr<Entry> &entry : entries)
+        {
+            if (entry->complete)
+                continue;
+            if (!entry->model)
+            {
+                if (!ready(entry->source))
+                    continue;
+                entry->parsed = entry->source.get();
+                entry->model.reset(new Model(entry->parsed, placeholder, entry->keepGeometry));
+                // images another model already loaded are shared right away, the others decoded
+                string directory = entry->parsed.directory;
+                for (const string &file : entry->parsed.texturePaths)
+                {
+                    GLuint texture = TextureCache::shared().acquire(directory + '/' + file);
+                    if (texture != 0)
+                        entry->model->setTexture(file, texture);
+                    entry->images.push_back(texture != 0 ? future<DecodedImage>()
+                                                         : ThreadPool::shared().submit([file, directory] { return DecodeImage(file.c_str(), directory); }));
+                }
+            }
+
+            // meshes in order; each hands its vertices and indices over to the Mesh, which frees them once on the GPU
+            vector<MeshCache::CachedMesh> &meshes = entry->parsed.meshes;
+            while (entry->nextMesh < meshes.size())
+            {
+                MeshCache::CachedMesh &mesh = meshes[entry->nextMesh];
+                size_t bytes = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+                for (const MeshLod &lod : mesh.lods)
+                    bytes += lod.indices.size() * sizeof(unsigned int);
+                if (!fits(bytes))
+                    return true;
+                entry->model->addMesh(std::move(mesh));
+                entry->nextMesh++;
+            }
+
+            // images in whatever order their decoding finishes
+            bool texturesDone = true;
+            for (size_t i = 0; i < entry->images.size(); i++)
+            {
+                if (entry->heldImage != i)
+                {
+                    future<DecodedImage> &image = entry->images[i];
+                    if (!image.valid())
+                        continue;
+                    if (!ready(image))
+                    {
+                        texturesDone = false;
+                        continue;
+                    }
+                    entry->held = image.get();
+                    entry->heldImage = i;
+                }
+                // its size is only known once decoded; one over the remaining budget waits for the next frame
+                if (!fits(entry->held.bytes()))
+                    return true;
+                entry->heldImage = Entry::NO_IMAGE;
+                const string &path = entry->parsed.texturePaths[i];
+                entry->model->setTexture(path, Model::shareTexture(entry->parsed.directory + '/' + path, entry->held, unpackBuffer));
+            }
+            if (texturesDone)
+            {
+                entry->complete = true;
+                entry->parsed = ModelSource();
+                entry->images.clear();
+            }
+        }
+        return !first;
+    }
+
+    // uploads everything, blocking until every model is complete; for runs that must not depend on load timing
+    void finish()
+    {
+        size_t budget = uploadBudget;
+        uploadBudget = ~static_cast<size_t>(0);
+        while (!idle())
+            if (!update())
+                std::this_thread::sleep_for(chrono::milliseconds(1));
+        uploadBudget = budget;
+    }
+
+    // the model once all its meshes are uploaded (its textures may still be placeholders), else null
+    Model *model(Handle handle) const
+    {
+        const Entry &entry = *entries[handle];
+        return entry.model && (entry.complete || entry.nextMesh == entry.parsed.meshes.size()) ? entry.model.get() : nullptr;
+    }
+
+    // whether the model's meshes and textures are all uploaded
+    bool complete(Handle handle) const
+    {
+        return entries[handle]->complete;
+    }
+
+    // whether every model is complete
+    bool idle() const
+    {
+        for (const unique_ptr<Entry> &entry : entries)
+            if (!entry->complete)
+                return false;
+        return true;
+    }
+
+private:
+    struct Entry {
+        // the read on the pool, then its result, which is emptied as it is uploaded
+        future<ModelSource> source;
+        ModelSource parsed;
+        unique_ptr<Model> model;
+        // one per parsed.texturePaths entry; invalid once uploaded
+        vector<future<DecodedImage>> images;
+        // a decoded image that didn't fit in its frame's budget, and its index in images (NO_IMAGE if none)
+        static const size_t NO_IMAGE = ~static_cast<size_t>(0);
+        DecodedImage held;
+        size_t heldImage;
+        size_t nextMesh;
+        bool keepGeometry;
+        bool complete;
+
+        Entry() : held(), heldImage(NO_IMAGE), nextMesh(0), keepGeometry(false), complete(false) {}
+    };
+
+    vector<unique_ptr<Entry>> entries;
+    GLuint placeholder;
+    GLuint unpackBuffer;
+
+    template<class T>
+    static bool ready(const future<T> &result)
+    {
+        return result.wait_for(chrono::seconds(0)) == future_status::ready;
+    }
+
+    static void freeImage(DecodedImage image)
+    {
+        FreeImage(image);
+    }
+};
+#endif
@@ -0,0 +1,910 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh_cache.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Fast path for Wavefront OBJ files, used instead of Assimp for the subset the scene's models are written in: `v`, `vt`,
+// `vn`, triangles and quads (`f`), objects (`o`) and groups (`g`, which start an object like Assimp maps them), materials
+// (`usemtl`, `mtllib`; only their texture maps are read), with smoothing groups ignored. The file is mapped and split at line boundaries into one chunk per pool
+// thread, parsed in parallel; the meshes are then built in parallel too. The result is what Model::read gets from Assimp
+// with MODEL_IMPORT_FLAGS: one mesh per object and material in file order, three vertices per triangle (four per
+// quad), v flipped, and the tangent frame computed and smoothed the way Assimp's CalcTangentSpace does. Anything else
+// (negative indices, polygons, lines, points, faces without normals, ...) makes read() fail and the model goes through
+// Assimp.
+namespace ObjParser
+{
+    // whether Model::read tries this parser for .obj files; off with --no-obj-parser
+    inline bool &enabled()
+    {
+        static bool value = true;
+        return value;
+    }
+
+    // a whole file, read only: mapped where mmap exists, otherwise read into memory
+    class MappedFile
+    {
+    public:
+        MappedFile() : address(NULL), length(0) {}
+        ~MappedFile()
+        {
+            close();
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const string &path)
+        {
+            close();
+#ifndef _WIN32
+            int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0)
+                return false;
+            struct stat status;
+            bool opened = fstat(descriptor, &status) == 0;
+            if (opened && status.st_size > 0)
+            {
+                void *mapping = mmap(NULL, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+                opened = mapping != MAP_FAILED;
+                if (opened)
+                {
+                    address = static_cast<const char *>(mapping);
+                    length = static_cast<size_t>(status.st_size);
+                }
+            }
+            ::close(descriptor);
+            return opened;
+#else
+            FILE *file = fopen(path.c_str(), "rb");
+            if (!file)
+                return false;
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            buffer.resize(size > 0 ? static_cast<size_t>(size) : 0);
+            bool opened = size >= 0 && fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+            fclose(file);
+            address = buffer.data();
+            length = buffer.size();
+            return opened;
+#endif
+        }
+
+        const char *begin() const
+        {
+            return address;
+        }
+        const char *end() const
+        {
+            return address + length;
+        }
+
+    private:
+        const char *address;
+        size_t length;
+#ifdef _WIN32
+        vector<char> buffer;
+#endif
+
+        void close()
+        {
+#ifndef _WIN32
+            if (address)
+                munmap(const_cast<char *>(address), length);
+#else
+            buffer.clear();
+#endif
+            address = NULL;
+            length = 0;
+        }
+    };
+
+    // --- numbers --------------------------------------------------------------------------------------------------
+
+    // the digits are read eight at a time from a 64-bit word (SIMD within a register), which needs the first character
+    // in the lowest byte
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define OBJ_PARSER_SWAR
+#endif
+
+    // index of the lowest set bit of a non-zero word
+    inline int lowestBit(uint64_t word)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    // the value of eight digits, one per byte as 0-9 with the most significant first
+    inline uint32_t eightDigits(uint64_t word)
+    {
+        word = word * 10 + (word >> 8);
+        word = ((word & 0x000000ff000000ffull) * 0x000f424000000064ull + ((word >> 16) & 0x000000ff000000ffull) * 0x0000271000000001ull) >> 32;
+        return static_cast<uint32_t>(word);
+    }
+
+    // appends the decimal digits at p to `value`, advancing p past them; returns how many there were. `value` is only
+    // meaningful for up to 19 digits.
+    inline int readDigits(const char *&p, const char *end, uint64_t &value)
+    {
+        static const uint64_t POWERS[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        int count = 0;
+#ifdef OBJ_PARSER_SWAR
+        while (end - p >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            // high bit of every byte that isn't '0'-'9'; no carry or borrow crosses a digit byte, so the lowest one
+            // marks the first non-digit
+            uint64_t nonDigits = ((word + 0x4646464646464646ull) | (word - 0x3030303030303030ull)) & 0x8080808080808080ull;
+            int digits = nonDigits != 0 ? lowestBit(nonDigits) / 8 : 8;
+            if (digits == 0)
+                return count;
+            // the digits moved to the top bytes, zeros (leading zeros) below them
+            word -= 0x3030303030303030ull;
+            if (digits < 8)
+                word <<= 8 * (8 - digits);
+            value = value * POWERS[digits] + eightDigits(word);
+            p += digits;
+            count += digits;
+            if (digits < 8)
+                return count;
+        }
+#endif
+        for (; p < end && static_cast<unsigned char>(*p - '0') < 10; p++, count++)
+            value = value * 10 + static_cast<unsigned char>(*p - '0');
+        return count;
+    }
+
+    inline void skipBlanks(const char *&p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    // anything strtof reads, for the numbers the fast path doesn't take
+    inline bool parseFloatSlow(const char *&p, const char *end, float &value)
+    {
+        char text[64];
+        size_t length = 0;
+        while (p + length < end && length + 1 < sizeof(text) && p[length] != ' ' && p[length] != '\t' && p[length] != '\r' && p[length] != '\n')
+        {
+            text[length] = p[length];
+            length++;
+        }
+        text[length] = '\0';
+        char *parsed;
+        value = strtof(text, &parsed);
+        if (parsed == text)
+            return false;
+        p += parsed - text;
+        return true;
+    }
+
+    // a decimal float after optional blanks. Up to 19 significant digits with a power of ten a double holds exactly
+    // take one double multiply or divide (Clinger's fast path, exact in double) and a rounding to float; the rest
+    // (long mantissas, large exponents, inf, nan) goes through strtof.
+    inline bool parseFloat(const char *&p, const char *end, float &value)
+    {
+        static const double POWERS[23] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        skipBlanks(p, end);
+        const char *start = p;
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        uint64_t mantissa = 0;
+        int digits = readDigits(p, end, mantissa);
+        int exponent = 0;
+        if (p < end && *p == '.')
+        {
+            p++;
+            int fraction = readDigits(p, end, mantissa);
+            digits += fraction;
+            exponent = -fraction;
+        }
+        bool fast = digits > 0 && digits <= 19 && mantissa <= (1ull << 53);
+        if (fast && p < end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            bool negativeExponent = p < end && *p == '-';
+            if (p < end && (*p == '-' || *p == '+'))
+                p++;
+            uint64_t magnitude = 0;
+            int exponentDigits = readDigits(p, end, magnitude);
+            fast = exponentDigits > 0 && exponentDigits <= 4;
+            exponent += negativeExponent ? -static_cast<int>(magnitude) : static_cast<int>(magnitude);
+        }
+        if (!fast || exponent < -22 || exponent > 22)
+        {
+            p = start;
+            return parseFloatSlow(p, end, value);
+        }
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / POWERS[-exponent] : result * POWERS[exponent];
+        value = static_cast<float>(negative ? -result : result);
+        return true;
+    }
+
+    // a vertex index as written (1-based); false for anything but a positive number
+    inline bool parseIndex(const char *&p, const char *end, uint32_t &index)
+    {
+        uint64_t value = 0;
+        int digits = readDigits(p, end, value);
+        if (digits == 0 || digits > 9 || value == 0)
+            return false;
+        index = static_cast<uint32_t>(value);
+        return true;
+    }
+
+    // the rest of the line without surrounding blanks
+    inline string restOfLine(const char *p, const char *end)
+    {
+        skipBlanks(p, end);
+        while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            end--;
+        return string(p, end);
+    }
+
+    // whether the statement at p is `keyword`, then skipping it
+    inline bool statement(const char *&p, const char *end, const char *keyword)
+    {
+        size_t length = strlen(keyword);
+        if (static_cast<size_t>(end - p) < length || memcmp(p, keyword, length) != 0)
+            return false;
+        const char *next = p + length;
+        if (next < end && *next != ' ' && *next != '\t' && *next != '\r')
+            return false;
+        p = next;
+        return true;
+    }
+
+    // --- parsing --------------------------------------------------------------------------------------------------
+
+    // position, texture coordinate and normal indices of a face corner, 1-based; 0 when the corner has none
+    struct Corner {
+        uint32_t position, texCoord, normal;
+    };
+
+    // an `o`, `g` or `usemtl` statement, taking effect from the chunk's face `face` on; `group` is the name of a `g`
+    struct GroupStatement {
+        size_t face, corner;
+        bool object;
+        string material, group;
+    };
+
+    // what one chunk of the file declares, in order; the indices in its corners are global
+    struct Chunk {
+        vector<float> positions, texCoords, normals; // 3, 2 and 3 per vertex
+        vector<Corner> corners;
+        vector<unsigned char> faceSizes;
+        vector<GroupStatement> groups;
+        vector<string> materialLibraries;
+        // the first statement this parser doesn't handle; the model then goes through Assimp
+        string unsupported;
+    };
+
+    inline void parseChunk(const char *begin, const char *end, Chunk &chunk)
+    {
+        for (const char *line = begin; line < end && chunk.unsupported.empty();)
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+            if (!lineEnd)
+                lineEnd = end;
+            const char *p = line;
+            line = lineEnd + 1;
+            skipBlanks(p, lineEnd);
+            if (p == lineEnd || *p == '#')
+                continue;
+            const char *text = p;
+            const char *last = lineEnd;
+            while (last > p && last[-1] == '\r')
+                last--;
+            if (last[-1] == '\\')
+            {
+                chunk.unsupported = "line continuation";
+                continue;
+            }
+
+            bool valid = true;
+            if (statement(p, lineEnd, "v"))
+            {
+                float xyz[3];
+                valid = parseFloat(p, lineEnd, xyz[0]) && parseFloat(p, lineEnd, xyz[1]) && parseFloat(p, lineEnd, xyz[2]);
+                chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+            }
+            else if (statement(p, lineEnd, "vt"))
+            {
+                float uv[2] = { 0.0f, 0.0f };
+                valid = parseFloat(p, lineEnd, uv[0]);
+                skipBlanks(p, lineEnd);
+                if (valid && p < lineEnd)
+                    valid = parseFloat(p, lineEnd, uv[1]);
+                chunk.texCoords.insert(chunk.texCoords.end(), uv, uv + 2);
+            }
+            else if (statement(p, lineEnd, "vn"))
+            {
+                float xyz[3];
+                valid = parseFloat(p, lineEnd, xyz[0]) && parseFloat(p, lineEnd, xyz[1]) && parseFloat(p, lineEnd, xyz[2]);
+                chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+            }
+            else if (statement(p, lineEnd, "f"))
+            {
+                size_t corners = 0;
+                for (;;)
+                {
+                    skipBlanks(p, lineEnd);
+                    if (p == lineEnd)
+                        break;
+                    Corner corner = { 0, 0, 0 };
+                    valid = parseIndex(p, lineEnd, corner.position);
+                    if (valid && p < lineEnd && *p == '/')
+                    {
+                        p++;
+                        if (p < lineEnd && *p != '/')
+                            valid = parseIndex(p, lineEnd, corner.texCoord);
+                        if (valid && p < lineEnd && *p == '/')
+                        {
+                            p++;
+                            valid = parseIndex(p, lineEnd, corner.normal);
+                        }
+                    }
+                    if (!valid)
+                        break;
+                    chunk.corners.push_back(corner);
+                    corners++;
+                }
+                if (valid && (corners < 3 || corners > 4))
+                {
+                    chunk.unsupported = "face with " + to_string(corners) + " corners";
+                    continue;
+                }
+                chunk.faceSizes.push_back(static_cast<unsigned char>(corners));
+            }
+            else if (statement(p, lineEnd, "o"))
+            {
+                GroupStatement group = { chunk.faceSizes.size(), chunk.corners.size(), true, string(), string() };
+                chunk.groups.push_back(group);
+            }
+            else if (statement(p, lineEnd, "g"))
+            {
+                GroupStatement group = { chunk.faceSizes.size(), chunk.corners.size(), true, string(), restOfLine(p, lineEnd) };
+                if (group.group.empty())
+                {
+                    chunk.unsupported = "unnamed group";
+                    continue;
+                }
+                chunk.groups.push_back(group);
+            }
+            else if (statement(p, lineEnd, "usemtl"))
+            {
+                GroupStatement group = { chunk.faceSizes.size(), chunk.corners.size(), false, restOfLine(p, lineEnd), string() };
+                chunk.groups.push_back(group);
+            }
+            else if (statement(p, lineEnd, "mtllib"))
+                chunk.materialLibraries.push_back(restOfLine(p, lineEnd));
+            else if (!statement(p, lineEnd, "s"))
+            {
+                chunk.unsupported = "statement '" + restOfLine(text, lineEnd).substr(0, 32) + "'";
+                continue;
+            }
+            if (!valid)
+                chunk.unsupported = "malformed line '" + restOfLine(text, lineEnd).substr(0, 32) + "'";
+        }
+    }
+
+    // --- materials ------------------------------------------------------------------------------------------------
+
+    // the texture maps of a material, by the sampler name Model gives their type (see Model::processMesh)
+    struct Material {
+        string name;
+        vector<MeshCache::TextureRef> textures;
+    };
+
+    // the file name of a texture map statement, after its options (-bm 0.5, -o 0 0 0, ...)
+    inline string textureFile(const char *p, const char *end)
+    {
+        static const struct {
+            const char *option;
+            int arguments;
+        } OPTIONS[] = { { "-blendu", 1 }, { "-blendv", 1 }, { "-boost", 1 }, { "-mm", 2 }, { "-o", 3 }, { "-s", 3 }, { "-t", 3 },
+                        { "-texres", 1 }, { "-clamp", 1 }, { "-bm", 1 }, { "-imfchan", 1 }, { "-type", 1 }, { "-cc", 1 } };
+        for (;;)
+        {
+            skipBlanks(p, end);
+            if (p == end || *p != '-')
+                break;
+            bool known = false;
+            for (const auto &option : OPTIONS)
+                if (statement(p, end, option.option))
+                {
+                    known = true;
+                    // optional trailing arguments (-o u [v [w]]) stop at the first one that isn't a number
+                    for (int i = 0; i < option.arguments; i++)
+                    {
+                        const char *argument = p;
+                        skipBlanks(argument, end);
+                        float number;
+                        const char *q = argument;
+                        if (i > 0 && !parseFloat(q, end, number))
+                            break;
+                        while (argument < end && *argument != ' ' && *argument != '\t' && *argument != '\r')
+                            argument++;
+                        p = argument;
+                    }
+                    break;
+                }
+            if (!known)
+                break;
+        }
+        return restOfLine(p, end);
+    }
+
+    // the materials of a .mtl file; false if it can't be read
+    inline bool readMaterials(const string &path, vector<Material> &materials)
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        static const struct {
+            const char *statement;
+            const char *type;
+        } MAPS[] = { { "map_Kd", "texture_diffuse" }, { "map_Ks", "texture_specular" }, { "map_Bump", "texture_normal" },
+                     { "map_bump", "texture_normal" },  { "bump", "texture_normal" },       { "map_Ka", "texture_height" } };
+        // Model lists a material's textures diffuse, specular, normal, height; the statements come in any order
+        static const char *ORDER[] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+        size_t firstOfFile = materials.size();
+        for (const char *line = file.begin(); line < file.end();)
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', file.end() - line));
+            if (!lineEnd)
+                lineEnd = file.end();
+            const char *p = line;
+            line = lineEnd + 1;
+            skipBlanks(p, lineEnd);
+            if (statement(p, lineEnd, "newmtl"))
+            {
+                Material material;
+                material.name = restOfLine(p, lineEnd);
+                materials.push_back(material);
+                continue;
+            }
+            if (materials.size() == firstOfFile)
+                continue;
+            for (const auto &map : MAPS)
+                if (statement(p, lineEnd, map.statement))
+                {
+                    MeshCache::TextureRef texture = { map.type, textureFile(p, lineEnd) };
+                    materials.back().textures.push_back(texture);
+                    break;
+                }
+        }
+        for (size_t i = firstOfFile; i < materials.size(); i++)
+            std::stable_sort(materials[i].textures.begin(), materials[i].textures.end(),
+                             [](const MeshCache::TextureRef &a, const MeshCache::TextureRef &b) {
+                                 return std::find(ORDER, ORDER + 4, a.type) < std::find(ORDER, ORDER + 4, b.type);
+                             });
+        return true;
+    }
+
+    // --- meshes ---------------------------------------------------------------------------------------------------
+
+    // the faces of one mesh: runs of consecutive faces in the chunks
+    struct FaceRun {
+        const Chunk *chunk;
+        size_t firstFace, firstCorner, faceCount;
+    };
+
+    struct MeshFaces {
+        string material;
+        vector<FaceRun> runs;
+        size_t corners, triangles;
+    };
+
+    // the vertex attributes of every chunk, concatenated
+    struct Attributes {
+        vector<float> positions, texCoords, normals;
+    };
+
+    inline void normalizeSafe(glm::vec3 &v)
+    {
+        float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        if (length > 0.0f)
+            v *= 1.0f / length;
+    }
+
+    inline bool special(const glm::vec3 &v)
+    {
+        return !std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z);
+    }
+
+    // Assimp's CalcTangentSpace on a mesh of unshared vertices: a tangent and bitangent per triangle from its positions
+    // and texture coordinates, made orthogonal to each vertex normal, then averaged over the vertices at the same
+    // position whose normals agree and whose tangent frames are within 45 degrees
+    inline void calculateTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices)
+    {
+        for (size_t i = 0; i + 3 <= indices.size(); i += 3)
+        {
+            const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+            glm::vec3 v = b.Position - a.Position, w = c.Position - a.Position;
+            float sx = b.TexCoords.x - a.TexCoords.x, sy = b.TexCoords.y - a.TexCoords.y;
+            float tx = c.TexCoords.x - a.TexCoords.x, ty = c.TexCoords.y - a.TexCoords.y;
+            float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+            // all three at one point in texture space: the default directions
+            if (sx * ty == sy * tx)
+            {
+                sx = 0.0f;
+                sy = 1.0f;
+                tx = 1.0f;
+                ty = 0.0f;
+            }
+            glm::vec3 tangent = (w * sy - v * ty) * direction;
+            glm::vec3 bitangent = (-w * sx + v * tx) * direction;
+            for (int k = 0; k < 3; k++)
+            {
+                Vertex &vertex = vertices[indices[i + k]];
+                const glm::vec3 &normal = vertex.Normal;
+                glm::vec3 localTangent = tangent - normal * glm::dot(tangent, normal);
+                glm::vec3 localBitangent = bitangent - normal * glm::dot(bitangent, normal) - localTangent * glm::dot(bitangent, localTangent);
+                normalizeSafe(localTangent);
+                normalizeSafe(localBitangent);
+                // one of them degenerate: rebuilt from the other
+                bool invalidTangent = special(localTangent), invalidBitangent = special(localBitangent);
+                if (invalidTangent && !invalidBitangent)
+                {
+                    localTangent = glm::cross(normal, localBitangent);
+                    normalizeSafe(localTangent);
+                }
+                else if (invalidBitangent && !invalidTangent)
+                {
+                    localBitangent = glm::cross(localTangent, normal);
+                    normalizeSafe(localBitangent);
+                }
+                vertex.Tangent = localTangent;
+                vertex.Bitangent = localBitangent;
+            }
+        }
+
+        // the vertices within a small distance of each other (1e-4 of the mesh's extent, as in Assimp) are found through
+        // their distances from the centroid along one axis: sorted by it, with their attributes packed in that order, the
+        // candidates for a vertex are its neighbours in the order, taken twice as far as needed so rounding never leaves
+        // one out
+        glm::vec3 lower(FLT_MAX), upper(-FLT_MAX), centroid(0.0f);
+        for (const Vertex &vertex : vertices)
+        {
+            lower = glm::min(lower, vertex.Position);
+            upper = glm::max(upper, vertex.Position);
+            centroid += vertex.Position;
+        }
+        centroid /= static_cast<float>(std::max<size_t>(1, vertices.size()));
+        const float epsilon = glm::length(upper - lower) * 1.0e-4f;
+        const glm::vec3 axis = glm::normalize(glm::vec3(0.8523f, 0.34321f, 0.5736f));
+        // the distance's bits made to order like the floats, above the vertex index
+        vector<uint64_t> keys(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            float distance = glm::dot(vertices[i].Position - centroid, axis);
+            uint32_t bits;
+            memcpy(&bits, &distance, sizeof(bits));
+            bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+            keys[i] = static_cast<uint64_t>(bits) << 32 | i;
+        }
+        std::sort(keys.begin(), keys.end());
+        struct Candidate {
+            glm::vec3 position, normal, tangent, bitangent;
+            float distance;
+            unsigned int vertex;
+        };
+        vector<Candidate> sorted(vertices.size());
+        vector<unsigned int> rank(vertices.size());
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            unsigned int i = static_cast<unsigned int>(keys[k]);
+            const Vertex &vertex = vertices[i];
+            Candidate candidate = { vertex.Position, vertex.Normal, vertex.Tangent, vertex.Bitangent,
+                                    glm::dot(vertex.Position - centroid, axis), i };
+            sorted[k] = candidate;
+            rank[i] = static_cast<unsigned int>(k);
+        }
+
+        const float limit = std::cos(glm::radians(45.0f));
+        vector<char> done(vertices.size(), 0);
+        vector<size_t> close;
+        for (unsigned int a = 0; a < vertices.size(); a++)
+        {
+            size_t origin = rank[a];
+            if (done[origin])
+                continue;
+            const Candidate &o = sorted[origin];
+            size_t first = origin;
+            while (first > 0 && sorted[first - 1].distance > o.distance - 2.0f * epsilon)
+                first--;
+            // like Assimp, the vertex itself is found again among the candidates and counts twice
+            close.assign(1, origin);
+            for (size_t k = first; k < sorted.size() && sorted[k].distance < o.distance + 2.0f * epsilon; k++)
+            {
+                const Candidate &c = sorted[k];
+                glm::vec3 offset = c.position - o.position;
+                if (done[k] || glm::dot(offset, offset) >= epsilon * epsilon || glm::dot(c.normal, o.normal) < 0.9999f
+                    || glm::dot(c.tangent, o.tangent) < limit || glm::dot(c.bitangent, o.bitangent) < limit)
+                    continue;
+                close.push_back(k);
+                done[k] = 1;
+            }
+            glm::vec3 tangent(0.0f), bitangent(0.0f);
+            for (size_t k : close)
+            {
+                tangent += sorted[k].tangent;
+                bitangent += sorted[k].bitangent;
+            }
+            normalizeSafe(tangent);
+            normalizeSafe(bitangent);
+            for (size_t k : close)
+            {
+                vertices[sorted[k].vertex].Tangent = tangent;
+                vertices[sorted[k].vertex].Bitangent = bitangent;
+            }
+        }
+    }
+
+    // the corner a quad is split from: its concave corner if it has one, as Assimp's Triangulate picks it
+    inline int quadStart(const glm::vec3 corners[4])
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            glm::vec3 left = corners[(i + 3) % 4] - corners[i], diagonal = corners[(i + 2) % 4] - corners[i], right = corners[(i + 1) % 4] - corners[i];
+            normalizeSafe(left);
+            normalizeSafe(diagonal);
+            normalizeSafe(right);
+            if (std::acos(glm::dot(left, diagonal)) + std::acos(glm::dot(right, diagonal)) > glm::pi<float>())
+                return i;
+        }
+        return 0;
+    }
+
+    // the vertices and indices of one mesh; false (with `error` set) for corners referring to missing attributes
+    inline bool buildMesh(const MeshFaces &faces, const Attributes &attributes, const vector<Material> &materials,
+                          MeshCache::CachedMesh &mesh, string &error)
+    {
+        const Corner &first = faces.runs.front().chunk->corners[faces.runs.front().firstCorner];
+        bool hasTexCoords = first.texCoord != 0, hasNormals = first.normal != 0;
+        if (!hasNormals)
+        {
+            error = "faces without normals";
+            return false;
+        }
+        size_t positionCount = attributes.positions.size() / 3, texCoordCount = attributes.texCoords.size() / 2;
+        size_t normalCount = attributes.normals.size() / 3;
+
+        mesh.vertices.resize(faces.corners);
+        mesh.indices.resize(faces.triangles * 3);
+        mesh.skinned = false;
+        size_t vertex = 0, index = 0;
+        for (const FaceRun &run : faces.runs)
+        {
+            const Corner *corner = &run.chunk->corners[run.firstCorner];
+            for (size_t face = run.firstFace; face < run.firstFace + run.faceCount; face++)
+            {
+                size_t size = run.chunk->faceSizes[face];
+                for (size_t k = 0; k < size; k++, corner++)
+                {
+                    if (corner->position > positionCount || corner->normal > normalCount || corner->texCoord > texCoordCount
+                        || (corner->texCoord != 0) != hasTexCoords || corner->normal == 0)
+                    {
+                        error = "face refers to a missing vertex attribute";
+                        return false;
+                    }
+                    Vertex &out = mesh.vertices[vertex + k];
+                    memcpy(&out.Position, &attributes.positions[(corner->position - 1) * 3], sizeof(glm::vec3));
+                    memcpy(&out.Normal, &attributes.normals[(corner->normal - 1) * 3], sizeof(glm::vec3));
+                    if (hasTexCoords)
+                    {
+                        const float *uv = &attributes.texCoords[(corner->texCoord - 1) * 2];
+                        out.TexCoords = glm::vec2(uv[0], 1.0f - uv[1]);
+                    }
+                }
+                unsigned int base = static_cast<unsigned int>(vertex);
+                if (size == 3)
+                {
+                    mesh.indices[index++] = base;
+                    mesh.indices[index++] = base + 1;
+                    mesh.indices[index++] = base + 2;
+                }
+                else
+                {
+                    glm::vec3 corners[4];
+                    for (int k = 0; k < 4; k++)
+                        corners[k] = mesh.vertices[vertex + k].Position;
+                    unsigned int start = static_cast<unsigned int>(quadStart(corners));
+                    const unsigned int triangles[6] = { 0, 1, 2, 0, 2, 3 };
+                    for (unsigned int k : triangles)
+                        mesh.indices[index++] = base + (start + k) % 4;
+                }
+                vertex += size;
+            }
+        }
+        if (hasTexCoords)
+            calculateTangents(mesh.vertices, mesh.indices);
+
+        for (const Material &material : materials)
+            if (material.name == faces.material)
+            {
+                mesh.textures = material.textures;
+                break;
+            }
+        return true;
+    }
+
+    // reads an .obj file into meshes as Model::read gets them from Assimp; false (with the reason printed) if the file
+    // can't be read or uses anything this parser leaves to Assimp. `maxChunks` 0 splits the file for every pool thread.
+    inline bool read(const string &path, vector<MeshCache::CachedMesh> &meshes, unsigned int maxChunks = 0)
+    {
+        meshes.clear();
+        MappedFile file;
+        if (!file.open(path))
+        {
+            cout << "obj: " << path << " can't be read" << endl;
+            return false;
+        }
+        ThreadPool &pool = ThreadPool::shared();
+
+        // chunks of at least 64 KiB, each ending after a newline
+        const size_t MIN_CHUNK = 64 << 10;
+        size_t size = file.end() - file.begin();
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(maxChunks != 0 ? maxChunks : pool.size(), size / MIN_CHUNK));
+        vector<const char *> bounds(1, file.begin());
+        for (size_t i = 1; i < chunkCount; i++)
+        {
+            const char *split = std::max(bounds.back(), file.begin() + size * i / chunkCount);
+            const char *newline = static_cast<const char *>(memchr(split, '\n', file.end() - split));
+            bounds.push_back(newline ? newline + 1 : file.end());
+        }
+        bounds.push_back(file.end());
+
+        // the caller's thread parses the first chunk while the pool parses the others
+        vector<Chunk> chunks(chunkCount);
+        vector<future<void>> parsed;
+        for (size_t i = 1; i < chunkCount; i++)
+        {
+            const char *begin = bounds[i], *end = bounds[i + 1];
+            Chunk *chunk = &chunks[i];
+            parsed.push_back(pool.submit([begin, end, chunk] { parseChunk(begin, end, *chunk); }));
+        }
+        parseChunk(bounds[0], bounds[1], chunks[0]);
+        for (future<void> &chunk : parsed)
+            pool.wait(chunk);
+
+        Attributes attributes;
+        vector<string> libraries;
+        for (const Chunk &chunk : chunks)
+        {
+            if (!chunk.unsupported.empty())
+            {
+                cout << "obj: " << path << " has a " << chunk.unsupported << ", importing it with Assimp" << endl;
+                return false;
+            }
+            attributes.positions.insert(attributes.positions.end(), chunk.positions.begin(), chunk.positions.end());
+            attributes.texCoords.insert(attributes.texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+            attributes.normals.insert(attributes.normals.end(), chunk.normals.begin(), chunk.normals.end());
+            libraries.insert(libraries.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+        }
+
+        // a mesh per object and material, in file order; statements that change neither leave the mesh going. Like
+        // Assimp, a `g` starts an object only when it names another group than the active one
+        string activeGroup;
+        vector<MeshFaces> groups(1);
+        groups.back().corners = groups.back().triangles = 0;
+        for (const Chunk &chunk : chunks)
+        {
+            size_t face = 0, corner = 0;
+            auto addFaces = [&](size_t endFace, size_t endCorner) {
+                if (endFace == face)
+                    return;
+                FaceRun run = { &chunk, face, corner, endFace - face };
+                MeshFaces &group = groups.back();
+                group.runs.push_back(run);
+                group.corners += endCorner - corner;
+                for (size_t f = face; f < endFace; f++)
+                    group.triangles += chunk.faceSizes[f] - 2;
+                face = endFace;
+                corner = endCorner;
+            };
+            for (const GroupStatement &statement : chunk.groups)
+            {
+                addFaces(statement.face, statement.corner);
+                if (!statement.object && statement.material == groups.back().material)
+                    continue;
+                if (!statement.group.empty())
+                {
+                    if (statement.group == activeGroup)
+                        continue;
+                    activeGroup = statement.group;
+                }
+                string material = statement.object ? groups.back().material : statement.material;
+                if (!groups.back().runs.empty())
+                    groups.push_back(MeshFaces());
+                groups.back().material = material;
+                groups.back().corners = groups.back().triangles = 0;
+            }
+            addFaces(chunk.faceSizes.size(), chunk.corners.size());
+        }
+        if (groups.back().runs.empty())
+            groups.pop_back();
+        if (groups.empty())
+        {
+            cout << "obj: " << path << " has no faces, importing it with Assimp" << endl;
+            return false;
+        }
+
+        vector<Material> materials;
+        string directory = path.substr(0, path.find_last_of('/'));
+        // a library that isn't there is replaced by the one named like the model, as Assimp does
+        for (const string &library : libraries)
+            if (!readMaterials(directory + '/' + library, materials))
+            {
+                string fallback = path.substr(0, path.size() - 3) + "mtl";
+                cout << "obj: material library " << directory + '/' + library << " can't be read, trying " << fallback << endl;
+                readMaterials(fallback, materials);
+            }
+
+        // each mesh built on the pool, the first one here
+        meshes.resize(groups.size());
+        vector<string> errors(groups.size());
+        vector<future<bool>> built;
+        for (size_t i = 1; i < groups.size(); i++)
+        {
+            const MeshFaces *faces = &groups[i];
+            MeshCache::CachedMesh *mesh = &meshes[i];
+            string *error = &errors[i];
+            const Attributes *source = &attributes;
+            const vector<Material> *library = &materials;
+            built.push_back(pool.submit([faces, source, library, mesh, error] { return buildMesh(*faces, *source, *library, *mesh, *error); }));
+        }
+        bool complete = buildMesh(groups[0], attributes, materials, meshes[0], errors[0]);
+        for (future<bool> &mesh : built)
+            complete = pool.wait(mesh) && complete;
+        if (!complete)
+        {
+            for (const string &error : errors)
+                if (!error.empty())
+                {
+                    cout << "obj: " << path << ": " << error << ", importing it with Assimp" << endl;
+                    break;
+                }
+            meshes.clear();
+            return false;
+        }
+        return true;
+    }
+}
+#endif
@@ -0,0 +1,269 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <table.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// State flags of a ball
+enum BallFlags : uint32_t {
+    BALL_IN_PLAY = 1,  // on the table (cleared once pocketed)
+    BALL_POCKETED = 2,
+    BALL_SLIDING = 4,  // contact point slips over the cloth
+    BALL_ROLLING = 8   // moving without slip
+};
+
+// State of all balls in structure-of-arrays form: every quantity is one contiguous, 32-byte aligned array indexed by
+// ball number, so the per-ball loops in PhysicsWorld::step compile to straight vector code. Positions are the ball
+// centres on the table plane (see table.h), angular velocity is in world axes.
+struct alignas(32) BallSet {
+    float px[Table::BALL_COUNT], pz[Table::BALL_COUNT];
+    float vx[Table::BALL_COUNT], vz[Table::BALL_COUNT];
+    float wx[Table::BALL_COUNT], wy[Table::BALL_COUNT], wz[Table::BALL_COUNT];
+    uint32_t flags[Table::BALL_COUNT];
+};
+
+// Fixed-timestep billiard simulation: sliding/rolling/spinning friction, ball-ball and ball-cushion collisions and
+// pockets. It has no rendering dependencies, so the same core runs under the render loop and headless.
+class PhysicsWorld
+{
+public:
+    static constexpr float FIXED_DT = 1.0f / 1000.0f;
+    // contact point speeds below this count as rolling, linear speeds below it as stopped
+    static constexpr float REST_SPEED = 1.0e-3f;
+
+    BallSet balls;
+    // first ball the cue ball touched since the last strike, -1 while it hasn't hit anything
+    int firstContact;
+
+    PhysicsWorld() : firstContact(-1), accumulator(0.0f)
+    {
+        rack();
+    }
+
+    // puts all balls back in their starting positions, at rest
+    void rack()
+    {
+        Table::rackPositions(balls.px, balls.pz);
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            balls.vx[i] = balls.vz[i] = 0.0f;
+            balls.wx[i] = balls.wy[i] = balls.wz[i] = 0.0f;
+            balls.flags[i] = BALL_IN_PLAY;
+        }
+        firstContact = -1;
+        accumulator = 0.0f;
+    }
+
+    // hits a ball in direction `angle` (radians from +x towards +z) at `speed` m/s. `follow` is top (+) or back (-)
+    // spin and `side` is side spin, both as multiples of the natural rolling spin speed / R.
+    void strike(int ball, float angle, float speed, float follow = 0.0f, float side = 0.0f)
+    {
+        const float R = Table::BALL_RADIUS;
+        float dx = std::cos(angle), dz = std::sin(angle);
+        balls.vx[ball] = dx * speed;
+        balls.vz[ball] = dz * speed;
+        // rolling spin about the horizontal axis perpendicular to the direction of travel, scaled by follow
+        balls.wx[ball] = follow * dz * speed / R;
+        balls.wz[ball] = -follow * dx * speed / R;
+        balls.wy[ball] = side * speed / R;
+        balls.flags[ball] = (balls.flags[ball] & ~BALL_ROLLING) | BALL_SLIDING;
+        if (ball == 0)
+            firstContact = -1;
+    }
+
+    // advances the simulation by frameSeconds using whole fixed steps; the remainder carries over to the next call
+    int update(float frameSeconds)
+    {
+        // don't try to catch up after a long stall (window dragged, breakpoint)
+        accumulator = std::min(accumulator + frameSeconds, 0.25f);
+        int steps = 0;
+        while (accumulator >= FIXED_DT)
+        {
+            step(FIXED_DT);
+            accumulator -= FIXED_DT;
+            steps++;
+        }
+        return steps;
+    }
+
+    bool moving() const
+    {
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+            if (balls.flags[i] & (BALL_SLIDING | BALL_ROLLING))
+                return true;
+        return false;
+    }
+
+    // one integration step of dt seconds
+    void step(float dt)
+    {
+        applyFriction(dt);
+        integrate(dt);
+        collideBalls();
+        collideCushions();
+        dropIntoPockets();
+    }
+
+private:
+    float accumulator;
+
+    // Friction of the cloth. While the contact point slips, sliding friction acts against the slip direction; this
+    // slows the ball and drives its spin towards natural roll, closing the slip at 7/2 mu_s g. Once rolling, only the
+    // much smaller rolling resistance remains and spin follows the velocity exactly.
+    void applyFriction(float dt)
+    {
+        const float R = Table::BALL_RADIUS;
+        const float slide = Table::SLIDING_FRICTION * Table::GRAVITY * dt;
+        const float roll = Table::ROLLING_FRICTION * Table::GRAVITY * dt;
+        const float spin = 2.5f * Table::SPINNING_FRICTION * Table::GRAVITY * dt / R;
+        float *__restrict vx = balls.vx, *__restrict vz = balls.vz;
+        float *__restrict wx = balls.wx, *__restrict wy = balls.wy, *__restrict wz = balls.wz;
+        uint32_t *__restrict flags = balls.flags;
+
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            float active = (flags[i] & BALL_IN_PLAY) ? 1.0f : 0.0f;
+
+            // velocity of the contact point relative to the cloth
+            float ux = vx[i] + R * wz[i];
+            float uz = vz[i] - R * wx[i];
+            float u = std::sqrt(ux * ux + uz * uz);
+            float sliding = u > REST_SPEED ? 1.0f : 0.0f;
+            float invU = sliding / std::max(u, REST_SPEED);
+            // fraction of the step spent sliding: the slip closes mid-step when it is smaller than one step's worth
+            float f = sliding * std::min(1.0f, u / (3.5f * slide));
+            float ix = ux * invU, iz = uz * invU;
+            vx[i] -= f * slide * ix;
+            vz[i] -= f * slide * iz;
+            wx[i] += f * slide * 2.5f / R * iz;
+            wz[i] -= f * slide * 2.5f / R * ix;
+
+            // rolling resistance for balls that roll by the end of the step, spin locked to the velocity
+            float rolling = f < 1.0f ? 1.0f : 0.0f;
+            float v = std::sqrt(vx[i] * vx[i] + vz[i] * vz[i]);
+            float keep = v > roll ? (v - roll) / v : 0.0f;
+            keep = rolling * keep + (1.0f - rolling);
+            vx[i] *= keep * active;
+            vz[i] *= keep * active;
+            wx[i] = rolling * vz[i] / R + (1.0f - rolling) * wx[i] * active;
+            wz[i] = -rolling * vx[i] / R + (1.0f - rolling) * wz[i] * active;
+
+            // spin around the vertical axis decays on its own
+            float s = std::fabs(wy[i]);
+            wy[i] = s > spin ? wy[i] * (s - spin) / s * active : 0.0f;
+
+            v = std::sqrt(vx[i] * vx[i] + vz[i] * vz[i]);
+            uint32_t motion = rolling == 0.0f ? BALL_SLIDING : (v > REST_SPEED ? BALL_ROLLING : 0u);
+            flags[i] = (flags[i] & ~(BALL_SLIDING | BALL_ROLLING)) | (active != 0.0f ? motion : 0u);
+        }
+    }
+
+    void integrate(float dt)
+    {
+        float *__restrict px = balls.px, *__restrict pz = balls.pz;
+        const float *__restrict vx = balls.vx, *__restrict vz = balls.vz;
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            px[i] += vx[i] * dt;
+            pz[i] += vz[i] * dt;
+        }
+    }
+
+    // elastic, frictionless collisions between equal balls: the normal components of the velocities are exchanged
+    // (less the restitution loss) and overlapping balls are pushed apart
+    void collideBalls()
+    {
+        const float minDist = 2.0f * Table::BALL_RADIUS;
+        float dist2[Table::BALL_COUNT];
+        for (int i = 0; i < Table::BALL_COUNT - 1; i++)
+        {
+            if (!(balls.flags[i] & BALL_IN_PLAY))
+                continue;
+            // distances to all other balls in one vectorizable pass, the rare contacts are resolved below
+            for (int j = 0; j < Table::BALL_COUNT; j++)
+            {
+                float dx = balls.px[j] - balls.px[i], dz = balls.pz[j] - balls.pz[i];
+                dist2[j] = dx * dx + dz * dz;
+            }
+            for (int j = i + 1; j < Table::BALL_COUNT; j++)
+            {
+                if (dist2[j] >= minDist * minDist || !(balls.flags[j] & BALL_IN_PLAY) || dist2[j] == 0.0f)
+                    continue;
+                float d = std::sqrt(dist2[j]);
+                float nx = (balls.px[j] - balls.px[i]) / d, nz = (balls.pz[j] - balls.pz[i]) / d;
+                float approach = (balls.vx[i] - balls.vx[j]) * nx + (balls.vz[i] - balls.vz[j]) * nz;
+                if (approach > 0.0f)
+                {
+                    float impulse = 0.5f * (1.0f + Table::BALL_RESTITUTION) * approach;
+                    balls.vx[i] -= impulse * nx;
+                    balls.vz[i] -= impulse * nz;
+                    balls.vx[j] += impulse * nx;
+                    balls.vz[j] += impulse * nz;
+                    balls.flags[i] |= BALL_SLIDING;
+                    balls.flags[j] |= BALL_SLIDING;
+                    if (i == 0 && firstContact < 0)
+                        firstContact = j;
+                }
+                float push = 0.5f * (minDist - d);
+                balls.px[i] -= push * nx;
+                balls.pz[i] -= push * nz;
+                balls.px[j] += push * nx;
+                balls.pz[j] += push * nz;
+            }
+        }
+    }
+
+    // reflects balls off the four cushions except where the pocket openings are
+    void collideCushions()
+    {
+        const float xMax = Table::LENGTH * 0.5f - Table::BALL_RADIUS;
+        const float zMax = Table::WIDTH * 0.5f - Table::BALL_RADIUS;
+        const float e = Table::CUSHION_RESTITUTION;
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            float x = balls.px[i], z = balls.pz[i];
+            bool cornerMouth = std::fabs(x) > Table::LENGTH * 0.5f - Table::CORNER_MOUTH
+                               && std::fabs(z) > Table::WIDTH * 0.5f - Table::CORNER_MOUTH;
+            bool sideMouth = std::fabs(x) < Table::SIDE_MOUTH;
+            if (!cornerMouth && std::fabs(x) > xMax && x * balls.vx[i] > 0.0f)
+            {
+                balls.px[i] = std::copysign(2.0f * xMax - std::fabs(x), x);
+                balls.vx[i] = -e * balls.vx[i];
+                balls.flags[i] |= BALL_SLIDING;
+            }
+            if (!cornerMouth && !sideMouth && std::fabs(z) > zMax && z * balls.vz[i] > 0.0f)
+            {
+                balls.pz[i] = std::copysign(2.0f * zMax - std::fabs(z), z);
+                balls.vz[i] = -e * balls.vz[i];
+                balls.flags[i] |= BALL_SLIDING;
+            }
+        }
+    }
+
+    // balls reaching a pocket, or leaving the bed through an opening, leave play
+    void dropIntoPockets()
+    {
+        for (int i = 0; i < Table::BALL_COUNT; i++)
+        {
+            if (!(balls.flags[i] & BALL_IN_PLAY))
+                continue;
+            bool dropped = std::fabs(balls.px[i]) > Table::LENGTH * 0.5f + Table::BALL_RADIUS
+                           || std::fabs(balls.pz[i]) > Table::WIDTH * 0.5f + Table::BALL_RADIUS;
+            for (int p = 0; p < Table::POCKET_COUNT && !dropped; p++)
+            {
+                float dx = balls.px[i] - Table::POCKET_X[p], dz = balls.pz[i] - Table::POCKET_Z[p];
+                dropped = dx * dx + dz * dz < Table::POCKET_RADIUS[p] * Table::POCKET_RADIUS[p];
+            }
+            if (dropped)
+            {
+                balls.flags[i] = BALL_POCKETED;
+                balls.vx[i] = balls.vz[i] = 0.0f;
+                balls.wx[i] = balls.wy[i] = balls.wz[i] = 0.0f;
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,454 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <gl_state.h>
+#include <gpu_timer.h>
+#include <shader.h>
+
+#include <stb_easy_font.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Frame profiler: named CPU scopes timed with the steady clock and named GPU passes timed with GL_TIME_ELAPSED
+// queries (GpuTimer, two queries per pass that are never waited for, so profiling doesn't stall the pipeline). Every
+// section keeps the per-frame totals of the last WINDOW frames for rolling min/avg/p99 statistics, which drawOverlay
+// renders as text over the frame, along with per-frame counts reported through count(). While tracing, every scope
+// and count is also recorded as a Chrome trace event (chrome://tracing, Perfetto) that writeTrace saves as JSON.
+//
+// GL_TIME_ELAPSED queries can't nest, so GPU passes must not overlap each other or any other timer query.
+class Profiler
+{
+public:
+    // frames covered by the rolling statistics
+    static const size_t WINDOW = 240;
+    // trace events kept at most, about 100 MB of JSON
+    static const size_t MAX_TRACE_EVENTS = 1000000;
+
+    struct Stats {
+        double min, avg, p99; // milliseconds
+        size_t samples;
+    };
+
+    // GPU passes are skipped when disabled, e.g. while a whole-frame timer query is active
+    bool gpuEnabled;
+    bool overlayVisible;
+
+    Profiler() : gpuEnabled(true), overlayVisible(false), tracing(false), frameOpen(false), vao(0), vbo(0), ebo(0)
+    {
+        origin = chrono::steady_clock::now();
+    }
+
+    ~Profiler()
+    {
+        if (vao)
+        {
+            GLState::current().forgetVertexArray(vao);
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(1, &vbo);
+            glDeleteBuffers(1, &ebo);
+        }
+    }
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // Times a CPU scope from construction to destruction
+    class CpuScope
+    {
+    public:
+        CpuScope(Profiler *profiler, size_t section) : profiler(profiler), section(section), start(chrono::steady_clock::now()) {}
+        CpuScope(CpuScope &&other) : profiler(other.profiler), section(other.section), start(other.start)
+        {
+            other.profiler = NULL;
+        }
+        ~CpuScope()
+        {
+            if (profiler)
+                profiler->endCpu(section, start);
+        }
+
+    private:
+        Profiler *profiler;
+        size_t section;
+        chrono::steady_clock::time_point start;
+    };
+
+    // Times a GPU pass from construction to destruction
+    class GpuScope
+    {
+    public:
+        GpuScope(Profiler *profiler, size_t section) : profiler(profiler), section(section) {}
+        GpuScope(GpuScope &&other) : profiler(other.profiler), section(other.section)
+        {
+            other.profiler = NULL;
+        }
+        ~GpuScope()
+        {
+            if (profiler)
+                profiler->endGpu(section);
+        }
+
+    private:
+        Profiler *profiler;
+        size_t section;
+    };
+
+    // starts a frame; sections not run during a frame count as 0 for it
+    void beginFrame()
+    {
+        frameStart = chrono::steady_clock::now();
+        frameOpen = true;
+        for (Section &section : sections)
+            section.frameMs = 0.0;
+    }
+
+    // ends the frame: adds each section's total to its statistics and picks up finished GPU measurements
+    void endFrame()
+    {
+        if (!frameOpen)
+            return;
+        frameOpen = false;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        size_t frame = sectionIndex("frame", false);
+        record(frame, chrono::duration<double, milli>(now - frameStart).count());
+        if (tracing)
+            addTraceEvent(frame, microseconds(frameStart), chrono::duration<double, micro>(now - frameStart).count());
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            Section &section = sections[i];
+            if (!section.gpu)
+                record(i, section.frameMs);
+            else if (section.timer)
+                collectGpu(i);
+        }
+    }
+
+    CpuScope cpu(const char *name)
+    {
+        return CpuScope(this, sectionIndex(name, false));
+    }
+
+    GpuScope gpu(const char *name)
+    {
+        if (!gpuEnabled)
+            return GpuScope(NULL, 0);
+        size_t index = sectionIndex(name, true);
+        Section &section = sections[index];
+        if (!section.timer)
+            section.timer.reset(new GpuTimer(2, false));
+        section.timer->begin();
+        section.issued.push_back(microseconds(chrono::steady_clock::now()));
+        return GpuScope(this, index);
+    }
+
+    // the most memory the process has had resident so far, or 0 where that isn't known (Windows)
+    static size_t peakResidentBytes()
+    {
+#ifndef _WIN32
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    // records a per-frame count, e.g. of state changes; the overlay shows the last value and the rolling average
+    void count(const char *name, double value)
+    {
+        size_t index = counters.size();
+        for (size_t i = 0; i < counters.size(); i++)
+            if (counters[i].name == name)
+                index = i;
+        if (index == counters.size())
+        {
+            counters.emplace_back();
+            counters.back().name = name;
+            counters.back().next = 0;
+        }
+        Counter &counter = counters[index];
+        counter.last = value;
+        if (counter.history.size() < WINDOW)
+            counter.history.push_back(value);
+        else
+            counter.history[counter.next] = value;
+        counter.next = (counter.next + 1) % WINDOW;
+        if (tracing && counterEvents.size() < MAX_TRACE_EVENTS)
+        {
+            CounterEvent event = { index, microseconds(chrono::steady_clock::now()), value };
+            counterEvents.push_back(event);
+        }
+    }
+
+    // rolling statistics of a section over the last WINDOW frames (all zero if it never ran)
+    Stats stats(const char *name, bool gpu) const
+    {
+        for (const Section &section : sections)
+            if (section.gpu == gpu && section.name == name)
+                return computeStats(section);
+        Stats empty = { 0.0, 0.0, 0.0, 0 };
+        return empty;
+    }
+
+    // starts recording trace events (from the next scope on)
+    void startTrace()
+    {
+        tracing = true;
+        traceEvents.reserve(4096);
+    }
+
+    // writes the recorded events in the Chrome trace event format; CPU scopes are on thread 1, GPU passes on thread 2,
+    // placed at the time they were issued since GL_TIME_ELAPSED only measures durations, and counts are counter tracks
+    bool writeTrace(const string &path) const
+    {
+        ofstream file(path.c_str());
+        if (!file)
+        {
+            cout << "ERROR::PROFILER:: can't write trace " << path << endl;
+            return false;
+        }
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        char line[256];
+        for (const TraceEvent &event : traceEvents)
+        {
+            const Section &section = sections[event.section];
+            snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     section.name.c_str(), section.gpu ? "gpu" : "cpu", section.gpu ? 2 : 1, event.start, event.duration);
+            file << line;
+        }
+        for (const CounterEvent &event : counterEvents)
+        {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                     counters[event.counter].name.c_str(), event.time, event.value);
+            file << line;
+        }
+        file << "\n]}\n";
+        cout << "trace with " << traceEvents.size() + counterEvents.size() << " events written to " << path << endl;
+        return true;
+    }
+
+    // draws the statistics table in the top left corner of a width x height viewport
+    void drawOverlay(int width, int height)
+    {
+        if (!overlayVisible)
+            return;
+        if (!vao)
+            createOverlay();
+
+        string text = "section           min     avg     p99 (ms)\n";
+        char line[128];
+        for (int gpu = 0; gpu < 2; gpu++)
+            for (const Section &section : sections)
+            {
+                if (section.gpu != (gpu == 1))
+                    continue;
+                Stats s = computeStats(section);
+                snprintf(line, sizeof(line), "%s %-12s %7.3f %7.3f %7.3f\n", gpu ? "gpu" : "cpu", section.name.c_str(), s.min, s.avg, s.p99);
+                text += line;
+            }
+        if (!counters.empty())
+            text += "\ncount                  last     avg\n";
+        for (const Counter &counter : counters)
+        {
+            double total = 0.0;
+            for (double value : counter.history)
+                total += value;
+            snprintf(line, sizeof(line), "%-20s %7.0f %7.1f\n", counter.name.c_str(), counter.last, total / counter.history.size());
+            text += line;
+        }
+
+        // stb_easy_font emits 4 vertices of 16 bytes (xyz float, rgba bytes) per quad
+        vector<char> vertices(text.size() * 270 + 1024);
+        unsigned char color[4] = { 0, 0, 0, 255 };
+        int quads = stb_easy_font_print(8.0f, 8.0f, &text[0], color, vertices.data(), static_cast<int>(vertices.size()));
+        quads = min(quads, MAX_OVERLAY_QUADS);
+
+        GLState::current().bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, quads * 64, vertices.data(), GL_STREAM_DRAW);
+        overlayShader->use();
+        overlayShader->setVector2f(screenSizeUniform, static_cast<float>(width), static_cast<float>(height));
+        overlayShader->setFloat(scaleUniform, 2.0f);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, 0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    static const int MAX_OVERLAY_QUADS = 65536;
+
+    struct Section {
+        string name;
+        bool gpu;
+        double frameMs;
+        vector<double> history; // ring of the last WINDOW frame totals
+        size_t next;
+        unique_ptr<GpuTimer> timer;
+        deque<double> issued;   // issue times (us) of GPU measurements not yet collected, for the trace
+    };
+
+    struct TraceEvent {
+        size_t section;
+        double start, duration; // microseconds
+    };
+
+    struct Counter {
+        string name;
+        double last;
+        vector<double> history; // ring of the last WINDOW values
+        size_t next;
+    };
+
+    struct CounterEvent {
+        size_t counter;
+        double time, value; // microseconds
+    };
+
+    vector<Section> sections;
+    chrono::steady_clock::time_point origin, frameStart;
+    bool tracing;
+    bool frameOpen;
+    vector<TraceEvent> traceEvents;
+    vector<Counter> counters;
+    vector<CounterEvent> counterEvents;
+
+    unique_ptr<Shader> overlayShader;
+    Uniform screenSizeUniform, scaleUniform;
+    GLuint vao, vbo, ebo;
+
+    double microseconds(chrono::steady_clock::time_point time) const
+    {
+        return chrono::duration<double, micro>(time - origin).count();
+    }
+
+    size_t sectionIndex(const char *name, bool gpu)
+    {
+        for (size_t i = 0; i < sections.size(); i++)
+            if (sections[i].gpu == gpu && sections[i].name == name)
+                return i;
+        sections.emplace_back();
+        Section &section = sections.back();
+        section.name = name;
+        section.gpu = gpu;
+        section.frameMs = 0.0;
+        section.next = 0;
+        return sections.size() - 1;
+    }
+
+    void endCpu(size_t index, chrono::steady_clock::time_point start)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        Section &section = sections[index];
+        section.frameMs += chrono::duration<double, milli>(now - start).count();
+        if (tracing)
+            addTraceEvent(index, microseconds(start), chrono::duration<double, micro>(now - start).count());
+    }
+
+    void endGpu(size_t index)
+    {
+        sections[index].timer->end();
+    }
+
+    void collectGpu(size_t index)
+    {
+        Section &section = sections[index];
+        for (double ms : section.timer->results)
+        {
+            double issued = section.issued.front();
+            section.issued.pop_front();
+            if (std::isnan(ms))
+                continue; // not ready in time, dropped rather than waited for
+            record(index, ms);
+            if (tracing)
+                addTraceEvent(index, issued, ms * 1000.0);
+        }
+        section.timer->results.clear();
+    }
+
+    void record(size_t index, double ms)
+    {
+        Section &section = sections[index];
+        if (section.history.size() < WINDOW)
+            section.history.push_back(ms);
+        else
+            section.history[section.next] = ms;
+        section.next = (section.next + 1) % WINDOW;
+    }
+
+    void addTraceEvent(size_t section, double start, double duration)
+    {
+        if (traceEvents.size() >= MAX_TRACE_EVENTS)
+            return;
+        TraceEvent event = { section, start, duration };
+        traceEvents.push_back(event);
+    }
+
+    static Stats computeStats(const Section &section)
+    {
+        Stats stats = { 0.0, 0.0, 0.0, section.history.size() };
+        if (section.history.empty())
+            return stats;
+        vector<double> sorted(section.history);
+        sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double ms : sorted)
+            total += ms;
+        stats.min = sorted.front();
+        stats.avg = total / sorted.size();
+        stats.p99 = sorted[static_cast<size_t>(ceil(0.99 * sorted.size())) - 1];
+        return stats;
+    }
+
+    void createOverlay()
+    {
+        overlayShader.reset(new Shader("../models/overlay/overlayShader.vs", "../models/overlay/overlayShader.fs"));
+        screenSizeUniform = overlayShader->uniform("screenSize");
+        scaleUniform = overlayShader->uniform("scale");
+
+        // quads as two triangles each
+        vector<GLuint> indices(MAX_OVERLAY_QUADS * 6);
+        for (GLuint q = 0; q < static_cast<GLuint>(MAX_OVERLAY_QUADS); q++)
+        {
+            GLuint quad[6] = { q * 4, q * 4 + 1, q * 4 + 2, q * 4, q * 4 + 2, q * 4 + 3 };
+            copy(quad, quad + 6, indices.begin() + q * 6);
+        }
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        GLState::current().bindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 16, (void *)12);
+    }
+};
+#endif
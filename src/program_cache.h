@@ -0,0 +1,175 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary, GL 4.1 or ARB_get_program_binary),
+// so later starts skip compiling and linking. Each program of a shader pair and set of defines has one file next to its
+// vertex shader (<vertex shader>.<hash of fragment path and defines>.programcache). The file is keyed by a hash of the
+// preprocessed sources (includes expanded, defines inserted) and the driver's vendor, renderer and version strings; a
+// stale key, or a binary the driver rejects, falls back to compiling from source, which rewrites the file.
+namespace ProgramCache
+{
+    // bump whenever the file layout changes
+    const uint32_t VERSION = 1;
+    const char MAGIC[8] = { 'B', 'G', 'L', 'P', 'R', 'O', 'G', '\0' };
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint64_t key;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    // --no-program-cache turns the cache off: every program is compiled and nothing is written
+    inline bool &enabled()
+    {
+        static bool value = true;
+        return value;
+    }
+
+    // 64-bit FNV-1a, continued from `hash`
+    inline uint64_t hash(const string &data, uint64_t hash = 14695981039346656037ull)
+    {
+        for (unsigned char c : data)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    inline bool supported()
+    {
+        if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // whether the driver still accepts binaries of `format` (a driver update can drop formats)
+    inline bool formatSupported(GLenum format)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        if (count <= 0)
+            return false;
+        vector<GLint> formats(count);
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        return std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) != formats.end();
+    }
+
+    inline string driverString()
+    {
+        string driver;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const GLubyte *value = glGetString(name);
+            driver += value ? reinterpret_cast<const char *>(value) : "";
+            driver += '\n';
+        }
+        return driver;
+    }
+
+    // the key of a program built from the given preprocessed sources with the current driver
+    inline uint64_t key(const string &vertexCode, const string &fragmentCode)
+    {
+        // the lengths keep the boundaries between the parts from being ambiguous
+        string lengths = to_string(vertexCode.size()) + ":" + to_string(fragmentCode.size());
+        return hash(fragmentCode, hash(vertexCode, hash(lengths, hash(driverString()))));
+    }
+
+    inline string cachePath(const string &vertexPath, const string &fragmentPath, const string &defines)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), ".%016llx.programcache", static_cast<unsigned long long>(hash(defines, hash(fragmentPath))));
+        return vertexPath + name;
+    }
+
+    // a linked program from the cache file, or 0 when there is no usable binary for this key
+    inline GLuint load(const string &path, uint64_t key)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return 0;
+        Header header;
+        vector<char> binary;
+        bool complete = fread(&header, sizeof(Header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                        && header.version == VERSION && header.key == key;
+        if (complete)
+        {
+            binary.resize(header.length);
+            complete = fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        fclose(file);
+        if (!complete || binary.empty() || !formatSupported(header.format))
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            std::cout << "program cache: binary " << path << " rejected by the driver, compiling" << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // writes a freshly linked program (linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT); failures only cost the next
+    // start another compile
+    inline bool store(const string &path, uint64_t key, GLuint program)
+    {
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return false;
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.key = key;
+        header.reserved = 0;
+        vector<char> buffer(sizeof(Header) + length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &written, &format, buffer.data() + sizeof(Header));
+        if (written <= 0)
+            return false;
+        header.format = format;
+        header.length = static_cast<uint32_t>(written);
+        memcpy(buffer.data(), &header, sizeof(Header));
+        buffer.resize(sizeof(Header) + written);
+
+        // write to a temporary name first so a crash never leaves a half-written file behind
+        string tmpPath = path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (!file)
+            return false;
+        bool complete = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        complete = fclose(file) == 0 && complete;
+        remove(path.c_str());
+        if (!complete || rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+#endif
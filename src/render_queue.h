@@ -0,0 +1,71 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+// Draws collected over a frame and issued sorted by state: program first, then material (texture), then vertex array,
+// then depth front to back. Consecutive items sharing a program, texture or vertex array then find it already bound,
+// and GLState skips the bind. Items are only issued by flush(), with their program in use.
+class RenderQueue
+{
+public:
+    // bits of each field in the sort key, from the most significant one
+    static const int PROGRAM_BITS = 12;
+    static const int MATERIAL_BITS = 16;
+    static const int VERTEX_ARRAY_BITS = 12;
+    static const int DEPTH_BITS = 24;
+
+    // depth is the normalized distance to the camera, [0, 1]
+    static uint64_t sortKey(GLuint program, GLuint material, GLuint vertexArray, float depth)
+    {
+        float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+        uint64_t depthBits = static_cast<uint64_t>(clamped * static_cast<float>((1 << DEPTH_BITS) - 1));
+        uint64_t key = program & ((1u << PROGRAM_BITS) - 1);
+        key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+        key = (key << VERTEX_ARRAY_BITS) | (vertexArray & ((1u << VERTEX_ARRAY_BITS) - 1));
+        return (key << DEPTH_BITS) | depthBits;
+    }
+
+    // queues a draw; `draw` issues it and binds whatever else it needs through GLState
+    void submit(Shader &shader, GLuint material, GLuint vertexArray, float depth, function<void()> draw)
+    {
+        Item item = { sortKey(shader.ID, material, vertexArray, depth), &shader, std::move(draw) };
+        items.push_back(std::move(item));
+    }
+
+    // issues the queued draws in key order and empties the queue; items with equal keys keep their submission order
+    void flush()
+    {
+        std::stable_sort(items.begin(), items.end(), [](const Item &a, const Item &b) { return a.key < b.key; });
+        for (Item &item : items)
+        {
+            item.shader->use();
+            item.draw();
+        }
+        items.clear();
+    }
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        Shader *shader;
+        function<void()> draw;
+    };
+
+    vector<Item> items;
+};
+#endif
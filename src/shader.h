@@ -3,26 +3,255 @@
 
 #include <glad/glad.h>
 
+#include "gl_state.h"
+#include "program_cache.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Pre-resolved uniform handle returned by Shader::uniform. It indexes the shader's slot table rather than holding the
+// GL location itself, so handles stay valid when the program is linked again.
+struct Uniform {
+    int slot;
+};
 
 class Shader
 {
 public:
     GLuint ID;
+    // unique per successful link across all shaders; lets callers cache per-program state such as sampler locations
+    unsigned int revision;
+    // whether the program came from the program binary cache instead of being compiled
+    bool loadedFromCache;
+
+    // `defines` (lines such as "#define COMPACT_VERTEX\n") is inserted after the #version line of both stages;
+    // `#include "file"` lines are expanded relative to the including file. The linked program is kept in the program
+    // binary cache (see program_cache.h) and taken from there on later starts
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "")
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), pendingProgram(0)
+    {
+        std::string vertexCode, fragmentCode;
+        readSources(vertexCode, fragmentCode);
+
+        bool cached = ProgramCache::enabled() && ProgramCache::supported();
+        uint64_t key = 0;
+        std::string cachePath;
+        ID = 0;
+        if (cached)
+        {
+            key = ProgramCache::key(vertexCode, fragmentCode);
+            cachePath = ProgramCache::cachePath(vertexPath, fragmentPath, defines);
+            ID = ProgramCache::load(cachePath, key);
+        }
+        loadedFromCache = ID != 0;
+        if (!loadedFromCache)
+        {
+            GLuint vertex = compileShader(vertexCode, GL_VERTEX_SHADER);
+            GLuint fragment = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
+            ID = compileProgram(vertex, fragment, cached);
+            if (cached)
+                ProgramCache::store(cachePath, key, ID);
+        }
+        loadUniforms();
+    }
+
+    Shader(std::string vShaderCode, std::string fShaderCode) : loadedFromCache(false), pendingProgram(0)
+    {
+        GLuint vertex = compileShader(vShaderCode, GL_VERTEX_SHADER);
+        GLuint fragment = compileShader(fShaderCode, GL_FRAGMENT_SHADER);
+        ID = compileProgram(vertex, fragment);
+        loadUniforms();
+    }
+
+    // files the program is built from: the two stages and everything they include (empty for a shader built from
+    // strings)
+    const std::vector<std::string> &sourceFiles() const {
+        return sources;
+    }
 
-    Shader(const char* vertexPath, const char* fragmentPath)
+    // Starts building the program again from its files, for shader hot reload. The build runs beside the live
+    // program, in the driver's compiler threads where KHR/ARB_parallel_shader_compile is available; finishReload()
+    // swaps it in. A reload started while another is pending replaces it. Returns false if the files can't be read.
+    bool beginReload()
+    {
+        if (vertexPath.empty())
+            return false;
+        std::string vertexCode, fragmentCode;
+        if (!readSources(vertexCode, fragmentCode))
+            return false;
+        discardReload();
+        pendingKey = ProgramCache::key(vertexCode, fragmentCode);
+        pendingVertex = glCreateShader(GL_VERTEX_SHADER);
+        pendingFragment = glCreateShader(GL_FRAGMENT_SHADER);
+        const char *code[2] = { vertexCode.c_str(), fragmentCode.c_str() };
+        glShaderSource(pendingVertex, 1, &code[0], NULL);
+        glShaderSource(pendingFragment, 1, &code[1], NULL);
+        glCompileShader(pendingVertex);
+        glCompileShader(pendingFragment);
+        pendingProgram = glCreateProgram();
+        glAttachShader(pendingProgram, pendingVertex);
+        glAttachShader(pendingProgram, pendingFragment);
+        if (ProgramCache::supported())
+            glProgramParameteri(pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        // no status queries here: they would wait for the compile
+        glLinkProgram(pendingProgram);
+        return true;
+    }
+
+    enum ReloadStatus { RELOAD_NONE, RELOAD_PENDING, RELOAD_FAILED, RELOAD_SWAPPED };
+
+    // Swaps in the program started by beginReload() once it is linked: the old program is deleted, the uniform
+    // table and handles are re-resolved and the revision changes, so per-program caches (sampler locations, uniform
+    // values set once at load) must be refreshed by the caller on RELOAD_SWAPPED. A failed build is reported and
+    // dropped, and the live program stays. Never waits for the driver when parallel compile is supported.
+    ReloadStatus finishReload()
+    {
+        if (pendingProgram == 0)
+            return RELOAD_NONE;
+        if (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile)
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return RELOAD_PENDING;
+        }
+        GLint linked = GL_FALSE;
+        glGetProgramiv(pendingProgram, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            checkCompile(pendingVertex, GL_VERTEX_SHADER);
+            checkCompile(pendingFragment, GL_FRAGMENT_SHADER);
+            checkLink(pendingProgram);
+            std::cout << "shader reload: " << vertexPath << " / " << fragmentPath << " failed, keeping the old program" << std::endl;
+            discardReload();
+            return RELOAD_FAILED;
+        }
+
+        GLState::current().forgetProgram(ID);
+        glDeleteProgram(ID);
+        ID = pendingProgram;
+        pendingProgram = 0;
+        glDeleteShader(pendingVertex);
+        glDeleteShader(pendingFragment);
+        if (ProgramCache::enabled() && ProgramCache::supported())
+            ProgramCache::store(ProgramCache::cachePath(vertexPath, fragmentPath, defines), pendingKey, ID);
+        loadedFromCache = false;
+        loadUniforms();
+        std::cout << "shader reload: " << vertexPath << " / " << fragmentPath << " swapped in" << std::endl;
+        return RELOAD_SWAPPED;
+    }
+
+    // a no-op when the program is already in use (see GLState)
+    void use() {
+        GLState::current().useProgram(ID);
+    }
+
+    // location of an active uniform from the table built after linking, -1 if the program has no such uniform
+    GLint location(const GLchar* name) const {
+        std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // resolves a uniform once, typically before the render loop; setting through the handle is a plain array lookup
+    Uniform uniform(const GLchar* name) {
+        for (size_t i = 0; i < slotNames.size(); i++)
+            if (slotNames[i] == name)
+                return Uniform{ static_cast<int>(i) };
+        slotNames.push_back(name);
+        slotLocations.push_back(location(name));
+        return Uniform{ static_cast<int>(slotNames.size() - 1) };
+    }
+
+    // connects a uniform block of the program to a binding point; remembered so a relinked program gets it again
+    void bindUniformBlock(const GLchar* blockName, GLuint binding) {
+        for (size_t i = 0; i < blockNames.size(); i++)
+            if (blockNames[i] == blockName)
+            {
+                blockNames.erase(blockNames.begin() + i);
+                blockBindings.erase(blockBindings.begin() + i);
+                break;
+            }
+        blockNames.push_back(blockName);
+        blockBindings.push_back(binding);
+        applyBlockBinding(blockNames.size() - 1);
+    }
+
+    // setters take either a name (hash lookup in the uniform table) or a pre-resolved handle (no lookup at all);
+    // like glUniform* they apply to the program currently in use
+    void setInteger(const GLchar *name, GLint value) {
+        glUniform1i(location(name), value);
+    }
+    void setInteger(Uniform uniform, GLint value) {
+        glUniform1i(slotLocations[uniform.slot], value);
+    }
+    void setFloat(const GLchar* name, GLfloat value) {
+        glUniform1f(location(name), value);
+    }
+    void setFloat(Uniform uniform, GLfloat value) {
+        glUniform1f(slotLocations[uniform.slot], value);
+    }
+    void setVector2f(const GLchar* name, GLfloat x, GLfloat y) {
+        glUniform2f(location(name), x, y);
+    }
+    void setVector2f(Uniform uniform, GLfloat x, GLfloat y) {
+        glUniform2f(slotLocations[uniform.slot], x, y);
+    }
+    void setVector3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z) {
+        glUniform3f(location(name), x, y, z);
+    }
+    void setVector3f(Uniform uniform, GLfloat x, GLfloat y, GLfloat z) {
+        glUniform3f(slotLocations[uniform.slot], x, y, z);
+    }
+    void setVector3f(const GLchar* name, const glm::vec3& value) {
+        glUniform3f(location(name), value.x, value.y, value.z);
+    }
+    void setVector3f(Uniform uniform, const glm::vec3& value) {
+        glUniform3f(slotLocations[uniform.slot], value.x, value.y, value.z);
+    }
+    void setMatrix4(const GLchar* name, const glm::mat4& matrix) {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(matrix));
+    }
+    void setMatrix4(Uniform uniform, const glm::mat4& matrix) {
+        glUniformMatrix4fv(slotLocations[uniform.slot], 1, GL_FALSE, glm::value_ptr(matrix));
+    }
+
+private:
+    // where the program was built from, for reloads; empty for a shader built from strings
+    std::string vertexPath, fragmentPath, defines;
+    std::vector<std::string> sources;
+    // the program being built by beginReload(), 0 if none
+    GLuint pendingProgram, pendingVertex, pendingFragment;
+    uint64_t pendingKey;
+
+    std::unordered_map<std::string, GLint> uniformLocations;
+    std::vector<std::string> slotNames;
+    std::vector<GLint> slotLocations;
+    std::vector<std::string> blockNames;
+    std::vector<GLuint> blockBindings;
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // reads both stages and preprocesses them, collecting the files they are made of; false if a file couldn't be read
+    bool readSources(std::string &vertexCode, std::string &fragmentCode)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         // ensure ifstream objects can throw exceptions:
         vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        bool read = true;
         try
         {
             // open files
@@ -42,49 +271,137 @@ public:
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            read = false;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        GLuint vertex = compileShader(vertexCode, GL_VERTEX_SHADER);
-        GLuint fragment = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
-        ID = compileProgram(vertex, fragment);
+        sources.clear();
+        sources.push_back(vertexPath);
+        sources.push_back(fragmentPath);
+        vertexCode = preprocess(vertexCode, vertexPath, defines, &sources);
+        fragmentCode = preprocess(fragmentCode, fragmentPath, defines, &sources);
+        return read;
     }
 
-    Shader(std::string vShaderCode, std::string fShaderCode)
+    void discardReload()
     {
-        GLuint vertex = compileShader(vShaderCode, GL_VERTEX_SHADER);
-        GLuint fragment = compileShader(fShaderCode, GL_FRAGMENT_SHADER);
-        ID = compileProgram(vertex, fragment);
+        if (pendingProgram == 0)
+            return;
+        glDeleteProgram(pendingProgram);
+        glDeleteShader(pendingVertex);
+        glDeleteShader(pendingFragment);
+        pendingProgram = 0;
     }
 
-    void use() {
-        glUseProgram(ID);
-    }
-    void setInteger(const GLchar *name, GLint value) {
-        glUniform1i(glGetUniformLocation(ID, name), value);
-    }
-    void setFloat(const GLchar* name, GLfloat value) {
-        glUniform1f(glGetUniformLocation(ID, name), value);
+    // replaces every `#include "file"` line with the file's (recursively expanded) contents; the included paths are
+    // added to `files` when given
+    static std::string expandIncludes(const std::string &code, const std::string &path, std::vector<std::string> *files = nullptr,
+                                      int depth = 0)
+    {
+        std::istringstream lines(code);
+        std::string expanded, line;
+        while (std::getline(lines, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start);
+                size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+                if (close != std::string::npos && depth < 16)
+                {
+                    std::string includePath = directoryOf(path) + line.substr(open + 1, close - open - 1);
+                    std::ifstream file(includePath);
+                    if (files && std::find(files->begin(), files->end(), includePath) == files->end())
+                        files->push_back(includePath);
+                    if (!file)
+                    {
+                        std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                        continue;
+                    }
+                    std::stringstream contents;
+                    contents << file.rdbuf();
+                    expanded += expandIncludes(contents.str(), includePath, files, depth + 1);
+                    continue;
+                }
+            }
+            expanded += line;
+            expanded += '\n';
+        }
+        return expanded;
     }
-    void setVector3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z) {
-        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+
+    static std::string preprocess(const std::string &code, const std::string &path, const std::string &defines,
+                                  std::vector<std::string> *files = nullptr)
+    {
+        std::string expanded = expandIncludes(code, path, files);
+        if (defines.empty())
+            return expanded;
+        // #version has to stay the first directive
+        size_t version = expanded.find("#version");
+        size_t insertAt = version == std::string::npos ? 0 : expanded.find('\n', version);
+        insertAt = insertAt == std::string::npos ? expanded.size() : insertAt + 1;
+        return expanded.substr(0, insertAt) + defines + expanded.substr(insertAt);
     }
-    void setVector3f(const GLchar* name, const glm::vec3& value) {
-        glUniform3f(glGetUniformLocation(ID, name), value.x, value.y, value.z);
+
+    void applyBlockBinding(size_t i)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockNames[i].c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, blockBindings[i]);
     }
-    void setMatrix4(const GLchar* name, const glm::mat4& matrix) {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+
+    // queries every active uniform of the freshly linked program once and re-resolves the handed out handles
+    void loadUniforms()
+    {
+        static unsigned int nextRevision = 1;
+        revision = nextRevision++;
+
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            GLint uniformLocation = glGetUniformLocation(ID, uniformName.c_str());
+            if (uniformLocation < 0)
+                continue; // uniforms living in a uniform block have no location
+            uniformLocations[uniformName] = uniformLocation;
+            // arrays are reported as "name[0]"; make the plain name and the other elements resolvable too
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = uniformName.substr(0, uniformName.size() - 3);
+                uniformLocations[base] = uniformLocation;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+
+        for (size_t i = 0; i < slotNames.size(); i++)
+            slotLocations[i] = location(slotNames[i].c_str());
+        for (size_t i = 0; i < blockNames.size(); i++)
+            applyBlockBinding(i);
     }
 
-private:
     GLuint compileShader(std::string shaderCode, GLenum shaderType)
     {
         GLuint shader = glCreateShader(shaderType);
         const char* code = shaderCode.c_str();
         glShaderSource(shader, 1, &code, NULL);
         glCompileShader(shader);
+        checkCompile(shader, shaderType);
+        return shader;
+    }
 
+    // prints the info log of a shader that failed to compile
+    static void checkCompile(GLuint shader, GLenum shaderType)
+    {
         GLchar infoLog[1024];
         GLint success;
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -100,18 +417,25 @@ private:
             }
             std::cout << "ERROR::SHADER_COMPILATION_ERROR of the " << t << ": " << shaderType << infoLog << std::endl;
         }
-        return shader;
     }
 
-    GLuint compileProgram(GLuint vertexShader, GLuint fragmentShader)
+    // `retrievable` asks the driver to keep the binary around for glGetProgramBinary
+    GLuint compileProgram(GLuint vertexShader, GLuint fragmentShader, bool retrievable = false)
     {
         GLuint programID = glCreateProgram();
 
         glAttachShader(programID, vertexShader);
         glAttachShader(programID, fragmentShader);
+        if (retrievable)
+            glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(programID);
+        checkLink(programID);
+        return programID;
+    }
 
-
+    // prints the info log of a program that failed to link
+    static void checkLink(GLuint programID)
+    {
         GLchar infoLog[1024];
         GLint success;
         glGetProgramiv(programID, GL_LINK_STATUS, &success);
@@ -120,7 +444,6 @@ private:
             glGetProgramInfoLog(programID, 1024, NULL, infoLog);
             std::cout << "ERROR::PROGRAM_LINKING_ERROR:  " << infoLog << std::endl;
         }
-        return programID;
     }
 
 };
@@ -0,0 +1,177 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Shader hot reload: watches the directories under a root (inotify, Linux only; elsewhere nothing is reported) and
+// rebuilds every watched shader one of whose files (stages or includes) was written. update() runs once per frame
+// and never blocks: it drains the pending file events, starts the rebuilds and swaps in the programs whose link has
+// finished, which with parallel shader compile is a later frame. A shader that fails to build keeps its old program.
+class ShaderWatcher
+{
+public:
+    explicit ShaderWatcher(const string &root) : descriptor(-1)
+    {
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0)
+        {
+            std::cout << "ERROR::SHADER_WATCHER::INOTIFY: shader hot reload disabled" << std::endl;
+            return;
+        }
+        addDirectory(root);
+#endif
+        // let the driver compile reloaded programs on as many threads as it likes
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if (GLAD_GL_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+
+    ~ShaderWatcher()
+    {
+#ifdef __linux__
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+    }
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    // `reloaded` runs after a new program is swapped in, with it in use, to set the uniforms the old one was given
+    // at load; the shader must outlive the watcher
+    void watch(Shader &shader, function<void(Shader &)> reloaded = nullptr)
+    {
+        Watched watched = { &shader, std::move(reloaded), canonicalFiles(shader) };
+        shaders.push_back(std::move(watched));
+    }
+
+    // returns how many programs were swapped in
+    int update()
+    {
+        set<string> changed = takeChangedFiles();
+        for (Watched &watched : shaders)
+            for (const string &file : watched.files)
+                if (changed.count(file))
+                {
+                    watched.shader->beginReload();
+                    break;
+                }
+
+        int swapped = 0;
+        for (Watched &watched : shaders)
+        {
+            if (watched.shader->finishReload() != Shader::RELOAD_SWAPPED)
+                continue;
+            // the includes may have changed
+            watched.files = canonicalFiles(*watched.shader);
+            if (watched.reloaded)
+            {
+                watched.shader->use();
+                watched.reloaded(*watched.shader);
+            }
+            swapped++;
+        }
+        return swapped;
+    }
+
+private:
+    struct Watched {
+        Shader *shader;
+        function<void(Shader &)> reloaded;
+        vector<string> files;
+    };
+
+    int descriptor;
+    // directory of each inotify watch
+    unordered_map<int, string> directories;
+    vector<Watched> shaders;
+
+    // paths are compared resolved, since includes are reached through "../"
+    static string canonical(const string &path)
+    {
+#ifdef __linux__
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+#endif
+        return path;
+    }
+
+    static vector<string> canonicalFiles(const Shader &shader)
+    {
+        vector<string> files;
+        for (const string &file : shader.sourceFiles())
+            files.push_back(canonical(file));
+        return files;
+    }
+
+#ifdef __linux__
+    // inotify watches aren't recursive, so every subdirectory gets its own
+    void addDirectory(const string &path)
+    {
+        // editors save either in place or by renaming a new file over the old one
+        int watch = inotify_add_watch(descriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch < 0)
+            return;
+        directories[watch] = canonical(path);
+        DIR *directory = opendir(path.c_str());
+        if (!directory)
+            return;
+        while (dirent *entry = readdir(directory))
+        {
+            string name = entry->d_name;
+            if (entry->d_type == DT_DIR && name != "." && name != "..")
+                addDirectory(path + "/" + name);
+        }
+        closedir(directory);
+    }
+#endif
+
+    // the files written since the last call, each once however many events it raised
+    set<string> takeChangedFiles()
+    {
+        set<string> changed;
+#ifdef __linux__
+        if (descriptor < 0)
+            return changed;
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(descriptor, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+            for (char *cursor = buffer; cursor < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(cursor);
+                unordered_map<int, string>::const_iterator directory = directories.find(event->wd);
+                if (directory != directories.end() && event->len > 0)
+                    changed.insert(directory->second + "/" + event->name);
+                cursor += sizeof(inotify_event) + event->len;
+            }
+        }
+#endif
+        return changed;
+    }
+};
+#endif
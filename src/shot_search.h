@@ -0,0 +1,193 @@
+#ifndef SHOT_SEARCH_H
+#define SHOT_SEARCH_H
+
+#include <event_simulation.h>
+#include <table.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <vector>
+
+// A cue ball strike, with the parameters of EventSimulation::strike
+struct Shot {
+    float angle, speed, follow, side;
+};
+
+// What a shot did and how good that is for the shooter
+struct ShotOutcome {
+    Shot shot;
+    float score;
+    int pocketed;      // object balls pocketed
+    bool scratch;      // cue ball pocketed
+    int firstContact;  // first ball hit, -1 for none
+    bool truncated;    // simulation hit EventSimulation::MAX_EVENTS, the end state is not physical
+    size_t candidate;  // index in the candidate list, breaks ties deterministically
+};
+
+struct ShotSearchResult {
+    std::vector<ShotOutcome> best; // best first
+    size_t candidates;             // shots generated
+    size_t evaluated;              // shots simulated before the budget ran out
+    size_t truncated;              // evaluated shots dropped because their simulation was truncated
+    double milliseconds;
+};
+
+// Searches for good cue ball shots from a table state. Every candidate is an independent shot resolved by its own
+// EventSimulation, so candidates are simulated in parallel on a work-stealing thread pool, in chunks, and each chunk
+// keeps its own best outcomes which are merged at the end. The search stops taking new candidates once the time
+// budget is spent; candidates are ordered most promising first, so a cut-off search still has the aimed shots.
+class ShotSearch
+{
+public:
+    // candidates simulated by one pool job
+    static const size_t CHUNK_SIZE = 16;
+
+    explicit ShotSearch(ThreadPool &pool = ThreadPool::shared()) : pool(pool) {}
+
+    // Candidate shots: aimed ones first (cue ball to the ghost ball position of every object ball / pocket pair, with
+    // a few nearby angles) at several speeds and spins, then a sweep of all directions
+    static std::vector<Shot> candidates(const BallSet &state)
+    {
+        static const float speeds[] = { 1.5f, 3.0f, 5.0f };
+        static const float follows[] = { -0.6f, 0.0f, 0.6f };
+        static const float sides[] = { -0.3f, 0.0f, 0.3f };
+        static const float offsets[] = { -0.01f, 0.0f, 0.01f };
+        std::vector<Shot> shots;
+        const float R = Table::BALL_RADIUS;
+        for (int ball = 1; ball < Table::BALL_COUNT; ball++)
+        {
+            if (!(state.flags[ball] & BALL_IN_PLAY))
+                continue;
+            for (int p = 0; p < Table::POCKET_COUNT; p++)
+            {
+                float dx = Table::POCKET_X[p] - state.px[ball], dz = Table::POCKET_Z[p] - state.pz[ball];
+                float d = std::sqrt(dx * dx + dz * dz);
+                // where the cue ball has to be when it touches the object ball to send it at the pocket
+                float gx = state.px[ball] - dx / d * 2.0f * R, gz = state.pz[ball] - dz / d * 2.0f * R;
+                float aim = std::atan2(gz - state.pz[0], gx - state.px[0]);
+                for (float offset : offsets)
+                    for (float speed : speeds)
+                        for (float follow : follows)
+                            for (float side : sides)
+                                shots.push_back(Shot{ aim + offset, speed, follow, side });
+            }
+        }
+        const int directions = 360;
+        for (int i = 0; i < directions; i++)
+            for (float speed : speeds)
+                shots.push_back(Shot{ 2.0f * 3.14159265f * i / directions, speed, 0.0f, 0.0f });
+        return shots;
+    }
+
+    // plays a shot from `state` and scores the result: +1 per object ball pocketed, the 8 ball only counting once it
+    // is the last one left, penalties for fouls (no ball hit, cue ball pocketed); softer shots win ties. A truncated
+    // simulation is flagged and gets the lowest score, search() drops it
+    static ShotOutcome evaluate(EventSimulation &simulation, const BallSet &state, const Shot &shot, size_t candidate = 0)
+    {
+        simulation.reset(state);
+        simulation.strike(0, shot.angle, shot.speed, shot.follow, shot.side);
+        BallSet end;
+        simulation.sample(std::numeric_limits<double>::infinity(), end);
+
+        ShotOutcome outcome;
+        outcome.shot = shot;
+        outcome.candidate = candidate;
+        outcome.firstContact = simulation.firstContact;
+        outcome.truncated = simulation.truncated;
+        outcome.scratch = (end.flags[0] & BALL_POCKETED) != 0;
+        outcome.pocketed = 0;
+        if (outcome.truncated)
+        {
+            outcome.score = -std::numeric_limits<float>::infinity();
+            return outcome;
+        }
+        int remaining = 0;
+        bool eightPocketed = false;
+        for (int ball = 1; ball < Table::BALL_COUNT; ball++)
+        {
+            if (!(state.flags[ball] & BALL_IN_PLAY))
+                continue;
+            if (end.flags[ball] & BALL_POCKETED)
+            {
+                outcome.pocketed++;
+                eightPocketed = eightPocketed || ball == 8;
+            }
+            else
+                remaining++;
+        }
+        float score = static_cast<float>(outcome.pocketed);
+        if (eightPocketed && remaining > 0)
+            score -= 5.0f;
+        if (outcome.scratch)
+            score -= 3.0f;
+        if (outcome.firstContact < 0)
+            score -= 1.0f;
+        outcome.score = score - 0.01f * shot.speed;
+        return outcome;
+    }
+
+    // best `keep` shots found from `state` within budgetMs of wall clock time
+    ShotSearchResult search(const BallSet &state, double budgetMs, size_t keep = 5)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // an unbounded budget (infinity) evaluates every candidate
+        std::chrono::steady_clock::time_point deadline = budgetMs < 1.0e9
+            ? start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budgetMs))
+            : std::chrono::steady_clock::time_point::max();
+        std::vector<Shot> shots = candidates(state);
+        std::atomic<size_t> evaluated(0);
+        std::atomic<size_t> truncated(0);
+
+        std::vector<std::future<std::vector<ShotOutcome>>> chunks;
+        for (size_t first = 0; first < shots.size(); first += CHUNK_SIZE)
+        {
+            size_t last = std::min(first + CHUNK_SIZE, shots.size());
+            chunks.push_back(pool.submit([&state, &shots, &evaluated, &truncated, deadline, first, last, keep] {
+                EventSimulation simulation;
+                std::vector<ShotOutcome> best;
+                for (size_t i = first; i < last && std::chrono::steady_clock::now() < deadline; i++)
+                {
+                    ShotOutcome outcome = evaluate(simulation, state, shots[i], i);
+                    evaluated++;
+                    if (outcome.truncated)
+                        truncated++;
+                    else
+                        best.push_back(outcome);
+                }
+                keepBest(best, keep);
+                return best;
+            }));
+        }
+
+        ShotSearchResult result;
+        for (std::future<std::vector<ShotOutcome>> &chunk : chunks)
+        {
+            std::vector<ShotOutcome> best = chunk.get();
+            result.best.insert(result.best.end(), best.begin(), best.end());
+        }
+        keepBest(result.best, keep);
+        result.candidates = shots.size();
+        result.evaluated = evaluated;
+        result.truncated = truncated;
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+private:
+    ThreadPool &pool;
+
+    static void keepBest(std::vector<ShotOutcome> &outcomes, size_t keep)
+    {
+        std::sort(outcomes.begin(), outcomes.end(), [](const ShotOutcome &a, const ShotOutcome &b) {
+            return a.score != b.score ? a.score > b.score : a.candidate < b.candidate;
+        });
+        if (outcomes.size() > keep)
+            outcomes.resize(keep);
+    }
+};
+#endif
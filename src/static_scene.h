@@ -0,0 +1,546 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "geometry_arena.h"
+#include "model.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// attribute holding the draw index in the multi-draw path; 0-6 are taken by Vertex, 7-12 by InstanceData
+#define DRAW_ID_ATTRIBUTE_LOCATION 13
+
+// Geometry that never moves (the table and the room), submitted as one batch drawn with models/static/staticShader.
+// Everything a draw needs is built once at load: the meshes' diffuse textures are copied, at their own resolution and
+// in their own (possibly block-compressed) format with their stored mip chain, into the layers of texture arrays (one
+// per format and size), and each draw's model and normal matrices, dequantization ranges and texture layer are packed
+// into a texture buffer. Where the context supports it, each array's draws are one glMultiDrawElementsIndirect, the
+// shader finding its draw through the command's baseInstance (an instanced attribute counting draws); otherwise each
+// draw is issued in turn with its index in a uniform. Either way the submission does no per-mesh texture binds or
+// uniform updates beyond that index and one bind per array. Draws whose world bounds are outside the view frustum are
+// dropped by cull() before any of this: only the visible draws' commands are submitted, each at the level of detail its
+// distance from the eye allows.
+class StaticScene
+{
+public:
+    // the vertex layout every added model must use; the meshes of one layout share an arena
+    VertexLayout layout;
+    // whether the batch is submitted with glMultiDrawElementsIndirect
+    bool indirect;
+    // whether cull() tests the draws against the frustum; when off every draw is visible
+    bool culling;
+
+    StaticScene(VertexLayout layout, bool allowIndirect = true)
+        : layout(layout), indirect(allowIndirect && indirectSupported()), culling(true), built(false),
+          drawBuffer(0), drawTexture(0), drawIdBuffer(0), commandBuffer(0), uniformRevision(0)
+    {
+    }
+
+    ~StaticScene()
+    {
+        for (MaterialArray &array : materials)
+        {
+            GLState::current().forgetTexture(array.texture);
+            glDeleteTextures(1, &array.texture);
+        }
+        GLState::current().forgetTexture(drawTexture);
+        glDeleteTextures(1, &drawTexture);
+        GLuint buffers[3] = { drawBuffer, drawIdBuffer, commandBuffer };
+        glDeleteBuffers(3, buffers);
+    }
+
+    StaticScene(const StaticScene &) = delete;
+    StaticScene &operator=(const StaticScene &) = delete;
+
+    // multi-draw indirect with a non-zero baseInstance needs GL 4.3, or the two extensions
+    static bool indirectSupported()
+    {
+        return GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance);
+    }
+
+    // adds every mesh of a model, placed by `transform`; the model must outlive the scene, and build() takes over its
+    // textures (see Model::releaseTextures), so it is drawn through the scene only
+    void add(Model &model, const glm::mat4 &transform)
+    {
+        if (model.vertexLayout != layout)
+        {
+            std::cout << "ERROR::STATIC_SCENE::LAYOUT_MISMATCH: model " << model.directory << " skipped" << std::endl;
+            return;
+        }
+        models.push_back(&model);
+        for (const Mesh &mesh : model.meshes)
+            if (mesh.range.indexCount > 0)
+                draws.push_back(Draw{ &mesh, transform, diffuseTexture(mesh), -1, -1,
+                                      transformBounds(mesh.bounds, transform), transformBounds(mesh.sphere, transform),
+                                      maxScale(transform) });
+    }
+
+    // uploads the draws added so far; call once, after the models' textures are loaded
+    void build()
+    {
+        buildMaterials();
+        // the arrays hold the only copy the scene needs; the 2D originals are freed unless other models share them
+        for (Model *model : models)
+            model->releaseTextures();
+        models.clear();
+        // draws sharing a texture array next to each other, by layer, then in arena order
+        std::sort(draws.begin(), draws.end(), [](const Draw &a, const Draw &b) {
+            if (a.array != b.array)
+                return a.array < b.array;
+            return a.layer != b.layer ? a.layer < b.layer : a.mesh->range.firstIndex < b.mesh->range.firstIndex;
+        });
+        buildDrawData();
+        if (indirect)
+            buildCommands();
+        for (const Draw &draw : draws)
+            bounds.add(draw.box, draw.sphere);
+        visible.assign(draws.size(), 1);
+        levels.assign(draws.size(), 0);
+        visibleDraws.clear();
+        for (size_t i = 0; i < draws.size(); i++)
+            visibleDraws.push_back(static_cast<GLuint>(i));
+        findRuns();
+        built = true;
+    }
+
+    // keeps the draws whose bounds reach into the frustum of `viewProjection` for the next draw(), and picks each one's
+    // level of detail from its distance to `eye`, `pixelsPerUnit` being the pixels a world unit spans at distance 1
+    // (Camera::GetPixelsPerUnit; the default draws the full meshes). The indirect commands are only rewritten when the
+    // set of visible draws or their levels change.
+    void cull(const glm::mat4 &viewProjection, const glm::vec3 &eye = glm::vec3(0.0f), float pixelsPerUnit = FLT_MAX)
+    {
+        if (!built)
+            return;
+        vector<uint8_t> nowVisible;
+        if (culling)
+            Frustum(viewProjection).cull(bounds, nowVisible);
+        else
+            nowVisible.assign(draws.size(), 1);
+        // the nearest point of the draw's bounding sphere decides; the level of a draw around the eye is the full mesh
+        vector<uint8_t> nowLevels(draws.size(), 0);
+        if (pixelsPerUnit < FLT_MAX)
+            for (size_t i = 0; i < draws.size(); i++)
+            {
+                float distance = glm::length(draws[i].sphere.center - eye) - draws[i].sphere.radius;
+                if (nowVisible[i] && distance > 0.0f)
+                    nowLevels[i] = static_cast<uint8_t>(draws[i].mesh->lodFor(pixelsPerUnit * draws[i].scale / distance));
+            }
+        if (nowVisible == visible && nowLevels == levels)
+            return;
+        visible.swap(nowVisible);
+        levels.swap(nowLevels);
+        visibleDraws.clear();
+        for (size_t i = 0; i < draws.size(); i++)
+            if (visible[i])
+                visibleDraws.push_back(static_cast<GLuint>(i));
+        findRuns();
+        if (indirect && !visibleDraws.empty())
+        {
+            // baseInstance keeps pointing at the draw's data, so the compacted commands only need their level's indices
+            vector<DrawElementsIndirectCommand> visibleCommands;
+            visibleCommands.reserve(visibleDraws.size());
+            for (GLuint i : visibleDraws)
+            {
+                DrawElementsIndirectCommand command = commands[i];
+                const GeometryArena::Range &range = draws[i].mesh->lodRange(levels[i]);
+                command.count = static_cast<GLuint>(range.indexCount);
+                command.firstIndex = static_cast<GLuint>(range.firstIndex);
+                visibleCommands.push_back(command);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, visibleCommands.size() * sizeof(DrawElementsIndirectCommand), visibleCommands.data());
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    }
+
+    // preprocessor definitions for the static scene program
+    string shaderDefines() const
+    {
+        string defines = layout == VERTEX_COMPACT ? "#define COMPACT_VERTEX\n" : "";
+        if (!indirect)
+            defines += "#define DRAW_ID_UNIFORM\n";
+        return defines;
+    }
+
+    // whether build() has run
+    bool ready() const
+    {
+        return built;
+    }
+
+    size_t drawCount() const
+    {
+        return draws.size();
+    }
+
+    // texture arrays holding the batch's textures, and their estimated GPU memory
+    size_t materialArrayCount() const
+    {
+        return materials.size();
+    }
+    size_t materialBytes() const
+    {
+        size_t bytes = 0;
+        for (const MaterialArray &array : materials)
+            for (GLint level = 0; level < array.levels; level++)
+                bytes += levelBytes(array, level) * array.layers.size();
+        return bytes;
+    }
+
+    // draws kept by the last cull(), and the ones it dropped
+    size_t visibleCount() const
+    {
+        return visibleDraws.size();
+    }
+    size_t culledCount() const
+    {
+        return draws.size() - visibleDraws.size();
+    }
+
+    // triangles the next draw() submits, at the levels the last cull() picked
+    size_t triangleCount() const
+    {
+        size_t triangles = 0;
+        for (GLuint i : visibleDraws)
+            triangles += draws[i].mesh->lodRange(levels[i]).indexCount / 3;
+        return triangles;
+    }
+
+    // draws the whole batch with `shader`, which must be in use and compiled with shaderDefines()
+    void draw(Shader &shader)
+    {
+        if (!built || visibleDraws.empty())
+            return;
+        GeometryArena &arena = GeometryArena::forLayout(layout);
+        arena.bind();
+
+        GLState::current().bindTexture(1, GL_TEXTURE_BUFFER, drawTexture);
+        // resolve the uniforms once per linked program instead of looking their names up every frame
+        if (uniformRevision != shader.revision)
+            resolveUniforms(shader);
+
+        if (indirect)
+        {
+            // the draw id attribute is only enabled for the batch, and instanced attributes of other draws must not
+            // be fetched with the commands' baseInstance
+            arena.detachInstances();
+            glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE_LOCATION);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            // the visible commands are in draw order, so each array's draws are one contiguous run of them
+            for (const Run &run : runs)
+            {
+                GLState::current().bindTexture(0, GL_TEXTURE_2D_ARRAY, arrayTexture(run.array));
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(run.first * sizeof(DrawElementsIndirectCommand)),
+                                            static_cast<GLsizei>(run.count), 0);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE_LOCATION);
+        }
+        else
+        {
+            for (GLuint i : visibleDraws)
+            {
+                GLState::current().bindTexture(0, GL_TEXTURE_2D_ARRAY, arrayTexture(draws[i].array));
+                shader.setInteger(drawIdUniform, static_cast<GLint>(i));
+                arena.draw(draws[i].mesh->lodRange(levels[i]));
+            }
+        }
+    }
+
+    // first texture array of the batch, for sort keys
+    GLuint materialTexture() const
+    {
+        return arrayTexture(0);
+    }
+
+private:
+    // vec4 texels per draw in the draw data buffer: model matrix (4), normal matrix (3), position scale + texture
+    // layer, position offset, texture coordinate transform
+    static const int DRAW_TEXELS = 10;
+
+    struct Draw {
+        const Mesh *mesh;
+        glm::mat4 transform;
+        GLuint texture;
+        // texture array and layer in it, both -1 for an untextured (white) mesh
+        int array, layer;
+        // world-space bounds
+        Aabb box;
+        BoundingSphere sphere;
+        // largest scale of the transform, turning model-space errors into world units
+        float scale;
+    };
+
+    // the textures of one format, size and mip count, one per layer; `format` is the textures' compressed format, or
+    // GL_RGBA8 for the uncompressed ones
+    struct MaterialArray {
+        GLuint texture;
+        GLenum format;
+        GLint width, height, levels;
+        vector<GLuint> layers;
+    };
+
+    // visible draws using the same texture array: visibleDraws[first, first + count)
+    struct Run {
+        int array;
+        size_t first, count;
+    };
+
+    // layout of glMultiDrawElementsIndirect's commands
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    vector<Draw> draws;
+    // models whose textures build() takes over
+    vector<Model *> models;
+    // every draw's command, in draw order; the command buffer holds the visible ones
+    vector<DrawElementsIndirectCommand> commands;
+    // the draws' world bounds, in draw order, and which of them the last cull() kept
+    CullSet bounds;
+    vector<uint8_t> visible;
+    vector<GLuint> visibleDraws;
+    // level of detail of each draw, as of the last cull()
+    vector<uint8_t> levels;
+    // runs of visibleDraws, as of the last cull()
+    vector<Run> runs;
+    bool built;
+    vector<MaterialArray> materials;
+    GLuint drawBuffer, drawTexture;
+    GLuint drawIdBuffer, commandBuffer;
+    // handles of the program the uniforms were resolved against
+    Uniform drawIdUniform;
+    unsigned int uniformRevision;
+
+    static float maxScale(const glm::mat4 &transform)
+    {
+        return std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    }
+
+    // points the samplers at their units, which the program keeps until it is linked again, and resolves the draw index
+    // uniform of the non-indirect path; `shader` must be in use
+    void resolveUniforms(Shader &shader)
+    {
+        shader.setInteger(shader.uniform("materials"), 0);
+        shader.setInteger(shader.uniform("drawData"), 1);
+        drawIdUniform = shader.uniform("drawId");
+        uniformRevision = shader.revision;
+    }
+
+    // the texture the lit shaders sample, texture_diffuse1; 0 if the mesh has none
+    static GLuint diffuseTexture(const Mesh &mesh)
+    {
+        for (const Texture &texture : mesh.textures)
+            if (texture.type == "texture_diffuse")
+                return texture.id;
+        return 0;
+    }
+
+    // the texture of array `array`; untextured draws keep whatever array is bound, the first one
+    GLuint arrayTexture(int array) const
+    {
+        return materials.empty() ? 0 : materials[array < 0 ? 0 : array].texture;
+    }
+
+    void findRuns()
+    {
+        runs.clear();
+        for (size_t i = 0; i < visibleDraws.size(); i++)
+        {
+            int array = draws[visibleDraws[i]].array;
+            if (runs.empty() || runs.back().array != array)
+                runs.push_back(Run{ array, i, 0 });
+            runs.back().count++;
+        }
+    }
+
+    // copies every distinct diffuse texture, with all its mip levels, into a layer of the texture array of its format
+    // and size, so no texture loses resolution, compression or its precomputed mips; an array holds at most
+    // GL_MAX_ARRAY_TEXTURE_LAYERS textures, more of one class start another
+    void buildMaterials()
+    {
+        GLint maxLayers = 256;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        for (Draw &draw : draws)
+        {
+            if (draw.texture == 0 || placed(draw.texture))
+                continue;
+            GLint textureWidth = 0, textureHeight = 0, compressed = GL_FALSE, internalFormat = 0, maxLevel = 1000;
+            GLState::current().bindTexture(0, GL_TEXTURE_2D, draw.texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
+            // textures that failed to load have no storage
+            if (textureWidth == 0 || textureHeight == 0)
+                continue;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+            glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+            GLenum format = compressed ? static_cast<GLenum>(internalFormat) : GL_RGBA8;
+            // compressed textures stop where the converter's chain does, the others have a full generated one
+            GLint levels = std::min(maxLevel + 1, static_cast<GLint>(Dds::levelCount(textureWidth, textureHeight)));
+            size_t array = 0;
+            while (array < materials.size() && (materials[array].format != format || materials[array].width != textureWidth
+                                                || materials[array].height != textureHeight || materials[array].levels != levels
+                                                || materials[array].layers.size() >= static_cast<size_t>(maxLayers)))
+                array++;
+            if (array == materials.size())
+                materials.push_back(MaterialArray{ 0, format, textureWidth, textureHeight, levels, vector<GLuint>() });
+            materials[array].layers.push_back(draw.texture);
+        }
+
+        // each level goes from its texture into a pack buffer and from there into its layer, staying on the GPU
+        GLuint staging;
+        glGenBuffers(1, &staging);
+        for (MaterialArray &array : materials)
+        {
+            bool compressed = array.format != GL_RGBA8;
+            GLsizei layers = static_cast<GLsizei>(array.layers.size());
+            glGenTextures(1, &array.texture);
+            for (GLint level = 0; level < array.levels; level++)
+            {
+                GLsizei width = std::max(1, array.width >> level), height = std::max(1, array.height >> level);
+                GLsizei size = static_cast<GLsizei>(levelBytes(array, level));
+                GLState::current().bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+                if (compressed)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.format, width, height, layers, 0, size * layers, NULL);
+                else
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, staging);
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_COPY);
+                for (GLsizei layer = 0; layer < layers; layer++)
+                {
+                    // both on unit 0, so the array stays the target of the upload
+                    GLState::current().bindTexture(0, GL_TEXTURE_2D, array.layers[layer]);
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER, staging);
+                    if (compressed)
+                        glGetCompressedTexImage(GL_TEXTURE_2D, level, (void*)0);
+                    else
+                        glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+                    if (compressed)
+                        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, array.format, size, (void*)0);
+                    else
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+            }
+            GLState::current().bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glDeleteBuffers(1, &staging);
+
+        for (Draw &draw : draws)
+            for (size_t array = 0; array < materials.size() && draw.texture != 0; array++)
+            {
+                vector<GLuint>::const_iterator it = std::find(materials[array].layers.begin(), materials[array].layers.end(), draw.texture);
+                if (it != materials[array].layers.end())
+                {
+                    draw.array = static_cast<int>(array);
+                    draw.layer = static_cast<int>(it - materials[array].layers.begin());
+                }
+            }
+    }
+
+    // whether the texture already has a layer
+    bool placed(GLuint texture) const
+    {
+        for (const MaterialArray &array : materials)
+            if (std::find(array.layers.begin(), array.layers.end(), texture) != array.layers.end())
+                return true;
+        return false;
+    }
+
+    // bytes of one layer of a level of the array
+    static size_t levelBytes(const MaterialArray &array, GLint level)
+    {
+        size_t width = static_cast<size_t>(std::max(1, array.width >> level)), height = static_cast<size_t>(std::max(1, array.height >> level));
+        if (array.format == GL_RGBA8)
+            return width * height * 4;
+        size_t blockBytes = array.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || array.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+        return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+    }
+
+    // packs the per-draw data into a texture buffer, in draw order
+    void buildDrawData()
+    {
+        vector<glm::vec4> texels;
+        texels.reserve(draws.size() * DRAW_TEXELS);
+        for (const Draw &draw : draws)
+        {
+            const VertexQuantization &quantization = draw.mesh->quantization;
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(draw.transform)));
+            for (int column = 0; column < 4; column++)
+                texels.push_back(draw.transform[column]);
+            for (int column = 0; column < 3; column++)
+                texels.push_back(glm::vec4(normalMatrix[column], 0.0f));
+            texels.push_back(glm::vec4(quantization.positionScale, static_cast<float>(draw.layer)));
+            texels.push_back(glm::vec4(quantization.positionOffset, 0.0f));
+            texels.push_back(quantization.texCoordTransform);
+        }
+
+        glGenBuffers(1, &drawBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, drawBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenTextures(1, &drawTexture);
+        GLState::current().bindTexture(1, GL_TEXTURE_BUFFER, drawTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawBuffer);
+    }
+
+    // one command per draw, its baseInstance being the draw's index, which the draw id attribute (advancing once per
+    // instance, and offset by baseInstance) hands to the shader
+    void buildCommands()
+    {
+        commands.clear();
+        vector<GLuint> drawIds;
+        for (size_t i = 0; i < draws.size(); i++)
+        {
+            const GeometryArena::Range &range = draws[i].mesh->range;
+            DrawElementsIndirectCommand command;
+            command.count = static_cast<GLuint>(range.indexCount);
+            command.instanceCount = 1;
+            command.firstIndex = static_cast<GLuint>(range.firstIndex);
+            command.baseVertex = range.baseVertex;
+            command.baseInstance = static_cast<GLuint>(i);
+            commands.push_back(command);
+            drawIds.push_back(static_cast<GLuint>(i));
+        }
+
+        glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        // the attribute is VAO state of the arena, left disabled outside draw()
+        glGenBuffers(1, &drawIdBuffer);
+        GeometryArena::forLayout(layout).bind();
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(DRAW_ID_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_ATTRIBUTE_LOCATION, 1);
+        GLState::current().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,68 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+// Dimensions and physical constants of a 9-ft pool table (WPA specification) and its balls, in meters, kilograms and
+// seconds. The table plane is x (length, foot rail at -x) / z (width) with the origin at the centre of the playing
+// surface; y points up. Ball i is the ball numbered i, 0 being the cue ball.
+namespace Table
+{
+    const int BALL_COUNT = 16;
+
+    // playing surface between the cushion noses
+    const float LENGTH = 2.54f;
+    const float WIDTH = 1.27f;
+
+    const float BALL_RADIUS = 0.028575f;
+    const float BALL_MASS = 0.17f;
+
+    // a ball whose centre comes this close to a pocket centre drops
+    const float CORNER_POCKET_RADIUS = 0.07f;
+    const float SIDE_POCKET_RADIUS = 0.065f;
+    // openings in the cushions: within CORNER_MOUTH of both rails at a corner, or within SIDE_MOUTH of the middle of a
+    // long rail, there is no cushion and the ball runs on into the pocket
+    const float CORNER_MOUTH = 0.08f;
+    const float SIDE_MOUTH = 0.06f;
+
+    const int POCKET_COUNT = 6;
+    const float POCKET_X[POCKET_COUNT] = { -LENGTH * 0.5f, 0.0f, LENGTH * 0.5f, -LENGTH * 0.5f, 0.0f, LENGTH * 0.5f };
+    const float POCKET_Z[POCKET_COUNT] = { -WIDTH * 0.5f, -WIDTH * 0.5f - 0.02f, -WIDTH * 0.5f, WIDTH * 0.5f, WIDTH * 0.5f + 0.02f, WIDTH * 0.5f };
+    const float POCKET_RADIUS[POCKET_COUNT] = { CORNER_POCKET_RADIUS, SIDE_POCKET_RADIUS, CORNER_POCKET_RADIUS,
+                                                CORNER_POCKET_RADIUS, SIDE_POCKET_RADIUS, CORNER_POCKET_RADIUS };
+
+    // spots on the long axis: the rack apex sits on the foot spot, the cue ball starts on the head string
+    const float FOOT_SPOT_X = -LENGTH * 0.25f;
+    const float HEAD_STRING_X = LENGTH * 0.25f;
+
+    const float GRAVITY = 9.81f;
+    // ball-cloth friction while the contact point slips, rolling resistance once it rolls, and the friction that
+    // slows down spin around the vertical axis
+    const float SLIDING_FRICTION = 0.2f;
+    const float ROLLING_FRICTION = 0.01f;
+    const float SPINNING_FRICTION = 0.044f;
+    // fraction of the normal relative speed kept by ball-ball and ball-cushion collisions
+    const float BALL_RESTITUTION = 0.95f;
+    const float CUSHION_RESTITUTION = 0.75f;
+
+    // standard 8-ball rack, apex first, 8 ball in the middle of the third row
+    const int RACK_ORDER[BALL_COUNT - 1] = { 1, 9, 2, 10, 8, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15 };
+
+    // fills x/z (indexed by ball number) with a full rack: object balls in a triangle on the foot spot, apex towards
+    // the head, and the cue ball on the head string
+    inline void rackPositions(float *x, float *z)
+    {
+        // a hair of spacing so the rack doesn't start in contact
+        const float diameter = BALL_RADIUS * 2.0f * 1.0005f;
+        const float rowSpacing = diameter * 0.8660254f; // sqrt(3)/2 of a diameter between touching rows
+        x[0] = HEAD_STRING_X;
+        z[0] = 0.0f;
+        int slot = 0;
+        for (int row = 0; row < 5; row++)
+            for (int i = 0; i <= row; i++)
+            {
+                int number = RACK_ORDER[slot++];
+                x[number] = FOOT_SPOT_X - row * rowSpacing;
+                z[number] = (i - row * 0.5f) * diameter;
+            }
+    }
+}
+#endif
@@ -0,0 +1,200 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// pixels of an image file decoded by stb_image, or the mip chain of a block-compressed .dds read as is; data is null
+// when decoding failed
+struct DecodedImage {
+    unsigned char *data;
+    int width, height, nrComponents;
+    // of the pixels and their size, filled in by the decoder (see TextureCache::contentHash); 0 when decoding failed
+    uint64_t hash;
+    // 0 for stb_image pixels; else the GL format of the compressed data, which holds `levels` mip levels in `size` bytes
+    GLenum compressedFormat;
+    int levels;
+    size_t size;
+
+    // bytes of data
+    size_t bytes() const
+    {
+        return compressedFormat != 0 ? size : static_cast<size_t>(width) * height * nrComponents;
+    }
+};
+
+// Process-wide owner of the GL textures loaded from image files, so models sharing an image (by path, or the same
+// pixels under another name) share one texture. Textures are reference counted: every acquire() or add() is a
+// reference, release() drops one and deletes the texture with the last. Lives on the GL thread.
+class TextureCache
+{
+public:
+    struct Stats {
+        size_t textures, references;
+        // estimated GPU memory of the textures, and of the uploads that sharing avoided
+        size_t bytes, bytesSaved;
+        // references served by path and by identical pixels
+        size_t pathHits, contentHits;
+    };
+
+    static TextureCache &shared()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // 64-bit FNV-1a of the image's size, format and data, eight bytes per step; safe on any thread
+    static uint64_t contentHash(const DecodedImage &image)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint64_t value) {
+            hash ^= value;
+            hash *= 1099511628211ull;
+        };
+        mix(static_cast<uint64_t>(image.width) << 32 | static_cast<uint32_t>(image.height));
+        mix(static_cast<uint64_t>(image.nrComponents) << 32 | image.compressedFormat);
+        size_t size = image.bytes(), i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, image.data + i, 8);
+            mix(word);
+        }
+        for (; i < size; i++)
+            mix(image.data[i]);
+        return hash;
+    }
+
+    // a new reference to the texture already loaded from this file, or 0 if there is none
+    GLuint acquire(const string &path)
+    {
+        unordered_map<string, GLuint>::const_iterator it = byPath.find(canonical(path));
+        if (it == byPath.end())
+            return 0;
+        Entry &entry = entries[it->second];
+        entry.references++;
+        counts.pathHits++;
+        counts.bytesSaved += entry.bytes;
+        return it->second;
+    }
+
+    // a new reference to the texture holding the same pixels as `image`, or 0 if there is none; on a hit the file is
+    // recorded under that texture and the image is freed with `freeImage`
+    GLuint acquire(const string &path, DecodedImage &image, void (*freeImage)(DecodedImage &))
+    {
+        if (!image.data)
+            return 0;
+        unordered_map<uint64_t, GLuint>::const_iterator it = byContent.find(image.hash);
+        if (it == byContent.end())
+            return 0;
+        Entry &entry = entries[it->second];
+        if (entry.width != image.width || entry.height != image.height || entry.components != image.nrComponents
+            || entry.compressedFormat != image.compressedFormat)
+            return 0;
+        entry.references++;
+        counts.contentHits++;
+        counts.bytesSaved += entry.bytes;
+        addPath(path, it->second);
+        freeImage(image);
+        return it->second;
+    }
+
+    // takes over a texture just uploaded from `image` (loaded from `path`), with one reference; the pixels may already
+    // be freed
+    void add(const string &path, const DecodedImage &image, GLuint texture)
+    {
+        Entry entry;
+        entry.references = 1;
+        entry.width = image.width;
+        entry.height = image.height;
+        entry.components = image.nrComponents;
+        entry.compressedFormat = image.compressedFormat;
+        entry.hash = image.hash;
+        entry.hashed = image.hash != 0; // a failed decode has no pixels to share
+        // compressed data already holds its mip chain; uncompressed images get a full one generated, which adds a third
+        entry.bytes = image.compressedFormat != 0 ? image.size : static_cast<size_t>(image.width) * image.height * image.nrComponents * 4 / 3;
+        entries[texture] = entry;
+        addPath(path, texture);
+        if (entry.hashed)
+            byContent[entry.hash] = texture;
+    }
+
+    // drops a reference; the last one deletes the texture. Names the cache doesn't own are ignored.
+    void release(GLuint texture)
+    {
+        unordered_map<GLuint, Entry>::iterator it = entries.find(texture);
+        if (it == entries.end() || --it->second.references > 0)
+            return;
+        for (unordered_map<string, GLuint>::iterator path = byPath.begin(); path != byPath.end();)
+            path = path->second == texture ? byPath.erase(path) : std::next(path);
+        unordered_map<uint64_t, GLuint>::iterator content = byContent.find(it->second.hash);
+        if (it->second.hashed && content != byContent.end() && content->second == texture)
+            byContent.erase(content);
+        entries.erase(it);
+        GLState::current().forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+
+    Stats stats() const
+    {
+        Stats stats = counts;
+        stats.textures = entries.size();
+        stats.references = 0;
+        stats.bytes = 0;
+        for (const pair<const GLuint, Entry> &entry : entries)
+        {
+            stats.references += entry.second.references;
+            stats.bytes += entry.second.bytes;
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        size_t references, bytes;
+        int width, height, components;
+        GLenum compressedFormat;
+        uint64_t hash;
+        bool hashed;
+    };
+
+    unordered_map<GLuint, Entry> entries;
+    unordered_map<string, GLuint> byPath;
+    unordered_map<uint64_t, GLuint> byContent;
+    // hits and savings so far; the other fields are computed by stats()
+    Stats counts;
+
+    TextureCache() : counts() {}
+
+    // the same file reached through different relative paths has one key
+    static string canonical(const string &path)
+    {
+#ifdef _WIN32
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, path.c_str(), _MAX_PATH))
+            return resolved;
+#else
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+#endif
+        return path;
+    }
+
+    void addPath(const string &path, GLuint texture)
+    {
+        byPath[canonical(path)] = texture;
+    }
+};
+#endif
@@ -0,0 +1,176 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing pool. Every worker owns a job deque: jobs submitted from outside the pool are dealt out
+// round-robin, jobs submitted by a worker go to its own deque. A worker runs its own jobs in submission order from the
+// front and, when its deque runs dry, steals from the back of another worker's, so uneven jobs still keep every core
+// busy without all workers contending on one queue. Jobs must not touch OpenGL: the context is only current on the
+// main thread.
+class ThreadPool
+{
+public:
+    // threadCount 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0) : pending(0), nextQueue(0), stopping(false)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < threadCount; i++)
+            queues.emplace_back(new WorkQueue());
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queues a job and returns a future for its result
+    template<class F>
+    auto submit(F job) -> std::future<decltype(job())>
+    {
+        typedef decltype(job()) Result;
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        push([task] { (*task)(); });
+        return result;
+    }
+
+    // the result of a submitted job. A worker waiting runs other jobs meanwhile (its own first), so a job can wait for
+    // jobs it submitted without every worker ending up blocked on work nobody is left to run.
+    template<class T>
+    T wait(std::future<T> &result)
+    {
+        const WorkerIdentity &self = identity();
+        if (self.pool == this)
+            while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                std::function<void()> job;
+                if (take(self.index, job))
+                    job();
+                else
+                    std::this_thread::yield();
+            }
+        return result.get();
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    // pool shared by the loaders and the shot search, created on first use
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    // the pool and queue index of the calling thread, if it is a worker
+    struct WorkerIdentity {
+        ThreadPool *pool;
+        unsigned int index;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending;
+    std::atomic<unsigned int> nextQueue;
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    bool stopping;
+
+    static WorkerIdentity &identity()
+    {
+        static thread_local WorkerIdentity current = { NULL, 0 };
+        return current;
+    }
+
+    void push(std::function<void()> job)
+    {
+        const WorkerIdentity &self = identity();
+        unsigned int index = self.pool == this ? self.index : nextQueue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->jobs.push_back(std::move(job));
+        }
+        pending++;
+        // taking the lock orders the increment before a sleeping worker's check of `pending`
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wakeup.notify_one();
+    }
+
+    // oldest job of the worker's own deque, otherwise the newest job of the first other deque that has one
+    bool take(unsigned int index, std::function<void()> &job)
+    {
+        for (unsigned int i = 0; i < queues.size(); i++)
+        {
+            WorkQueue &queue = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty())
+                continue;
+            if (i == 0)
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            else
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+            pending--;
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        identity().pool = this;
+        identity().index = index;
+        for (;;)
+        {
+            std::function<void()> job;
+            if (take(index, job))
+            {
+                job();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeup.wait(lock, [this] { return stopping || pending > 0; });
+            if (stopping && pending == 0)
+                return;
+        }
+    }
+};
+#endif
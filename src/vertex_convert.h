@@ -0,0 +1,413 @@
+#ifndef VERTEX_CONVERT_H
+#define VERTEX_CONVERT_H
+
+#include "vertex_format.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+// AVX2 is picked at run time (the build targets baseline x86-64), which needs GCC/Clang's target attribute
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VERTEX_CONVERT_AVX2
+#endif
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// Bulk vertex conversion of whole meshes at import and upload:
+//   interleave()  copies the importer's separate position/normal/UV/tangent/bitangent arrays into Vertex
+//   compact()     normalizes the tangent frame and quantizes to CompactVertex (see vertex_format.h), four or eight
+//                 vertices per step, one SIMD lane per vertex
+// Each has a scalar version and an SSE2 kernel; compact() also has an 8-wide AVX2 kernel, chosen at run time when the
+// CPU has it. All kernels produce bit-identical output (the same operations in the same order, rounding to nearest even).
+namespace VertexConvert
+{
+    static_assert(sizeof(CompactVertex) == 20, "the SIMD kernels store CompactVertex as five 32-bit words");
+
+    enum Kernel { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+    inline const char *kernelName(Kernel kernel)
+    {
+        return kernel == KERNEL_AVX2 ? "avx2" : kernel == KERNEL_SSE2 ? "sse2" : "scalar";
+    }
+
+    inline bool available(Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case KERNEL_SCALAR:
+            return true;
+        case KERNEL_SSE2:
+#ifdef __SSE2__
+            return true;
+#else
+            return false;
+#endif
+        case KERNEL_AVX2:
+#ifdef VERTEX_CONVERT_AVX2
+        {
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+        }
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    inline Kernel bestKernel()
+    {
+        return available(KERNEL_AVX2) ? KERNEL_AVX2 : available(KERNEL_SSE2) ? KERNEL_SSE2 : KERNEL_SCALAR;
+    }
+
+    // the importer's per-attribute arrays, three floats per vertex each (of texCoords only x and y are used); null for
+    // attributes the mesh doesn't have
+    struct AttributeStreams {
+        const float *positions, *normals, *texCoords, *tangents, *bitangents;
+        size_t count;
+    };
+
+    // fills the vertices' attributes from the streams in one pass over the vertices, so each Vertex (88 bytes, most of
+    // it bone data left alone) is written once; attributes without a stream are left as they are, so the vertices
+    // should be value-initialized
+    inline void interleave(const AttributeStreams &streams, Vertex *vertices, Kernel kernel = bestKernel())
+    {
+        const float *positions = streams.positions, *normals = streams.normals, *texCoords = streams.texCoords;
+        const float *tangents = streams.tangents, *bitangents = streams.bitangents;
+        size_t i = 0;
+#ifdef __SSE2__
+        if (kernel != KERNEL_SCALAR && available(kernel))
+        {
+            // one unaligned load of x, y, z (and the next vertex's x) per attribute, stored as 8 + 4 bytes so the
+            // following field isn't touched; the last vertex is left to the scalar loop, its loads would run past the
+            // streams
+            auto copy3 = [](const float *source, glm::vec3 &field) {
+                __m128 value = _mm_loadu_ps(source);
+                _mm_storel_pi(reinterpret_cast<__m64 *>(&field), value);
+                _mm_store_ss(&field.z, _mm_movehl_ps(value, value));
+            };
+            for (; i + 1 < streams.count; i++)
+            {
+                Vertex &vertex = vertices[i];
+                copy3(positions + 3 * i, vertex.Position);
+                if (normals)
+                    copy3(normals + 3 * i, vertex.Normal);
+                if (texCoords)
+                    _mm_storel_pi(reinterpret_cast<__m64 *>(&vertex.TexCoords), _mm_loadu_ps(texCoords + 3 * i));
+                if (tangents)
+                    copy3(tangents + 3 * i, vertex.Tangent);
+                if (bitangents)
+                    copy3(bitangents + 3 * i, vertex.Bitangent);
+            }
+        }
+#endif
+        for (; i < streams.count; i++)
+        {
+            Vertex &vertex = vertices[i];
+            memcpy(&vertex.Position, positions + 3 * i, sizeof(glm::vec3));
+            if (normals)
+                memcpy(&vertex.Normal, normals + 3 * i, sizeof(glm::vec3));
+            if (texCoords)
+                memcpy(&vertex.TexCoords, texCoords + 3 * i, sizeof(glm::vec2));
+            if (tangents)
+                memcpy(&vertex.Tangent, tangents + 3 * i, sizeof(glm::vec3));
+            if (bitangents)
+                memcpy(&vertex.Bitangent, bitangents + 3 * i, sizeof(glm::vec3));
+        }
+    }
+
+#ifdef __SSE2__
+    namespace Sse2
+    {
+        // x, y and z of a vec3 field of four vertices
+        inline void load(const Vertex *vertices, size_t fieldOffset, __m128 &x, __m128 &y, __m128 &z)
+        {
+            const char *base = reinterpret_cast<const char *>(vertices) + fieldOffset;
+            // each load also takes the float after the field, which is still inside Vertex
+            __m128 a = _mm_loadu_ps(reinterpret_cast<const float *>(base));
+            __m128 b = _mm_loadu_ps(reinterpret_cast<const float *>(base + sizeof(Vertex)));
+            __m128 c = _mm_loadu_ps(reinterpret_cast<const float *>(base + 2 * sizeof(Vertex)));
+            __m128 d = _mm_loadu_ps(reinterpret_cast<const float *>(base + 3 * sizeof(Vertex)));
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            x = a;
+            y = b;
+            z = c;
+        }
+
+        inline __m128 abs(__m128 v)
+        {
+            return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+        }
+
+        inline __m128 select(__m128 mask, __m128 a, __m128 b)
+        {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        // (x + y) + z, glm's order
+        inline __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+        {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        }
+
+        // safeDirection(): the normalized vector, or the fallback where it has no usable length
+        inline void normalize(__m128 &x, __m128 &y, __m128 &z, __m128 fx, __m128 fy, __m128 fz)
+        {
+            __m128 length = _mm_sqrt_ps(dot(x, y, z, x, y, z));
+            __m128 valid = _mm_and_ps(_mm_cmpgt_ps(length, _mm_set1_ps(1.0e-12f)), _mm_cmple_ps(length, _mm_set1_ps(FLT_MAX)));
+            x = select(valid, _mm_div_ps(x, length), fx);
+            y = select(valid, _mm_div_ps(y, length), fy);
+            z = select(valid, _mm_div_ps(z, length), fz);
+        }
+
+        // octahedralEncode()
+        inline void octahedral(__m128 x, __m128 y, __m128 z, __m128 &u, __m128 &v)
+        {
+            __m128 sum = _mm_add_ps(_mm_add_ps(abs(x), abs(y)), abs(z));
+            x = _mm_div_ps(x, sum);
+            y = _mm_div_ps(y, sum);
+            z = _mm_div_ps(z, sum);
+            __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+            __m128 signX = select(_mm_cmpge_ps(x, zero), one, _mm_set1_ps(-1.0f));
+            __m128 signY = select(_mm_cmpge_ps(y, zero), one, _mm_set1_ps(-1.0f));
+            __m128 lower = _mm_cmplt_ps(z, zero);
+            u = select(lower, _mm_mul_ps(_mm_sub_ps(one, abs(y)), signX), x);
+            v = select(lower, _mm_mul_ps(_mm_sub_ps(one, abs(x)), signY), y);
+        }
+
+        // packSnorm16() / packUnorm16() before the narrowing, as 32-bit integers
+        inline __m128i snorm16(__m128 v)
+        {
+            v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+            return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(32767.0f)));
+        }
+        inline __m128i unorm16(__m128 v)
+        {
+            v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(65535.0f)));
+        }
+
+        // writes four CompactVertex from their ten 16-bit fields (in CompactVertex's order), one __m128i of 32-bit
+        // values per field: pairs of fields are packed into words, and the five words transposed to one row per vertex
+        inline void store(const __m128i fields[10], CompactVertex *packed)
+        {
+            const __m128i low = _mm_set1_epi32(0xffff);
+            __m128 words[5];
+            for (int w = 0; w < 5; w++)
+                words[w] = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(fields[2 * w], low), _mm_slli_epi32(fields[2 * w + 1], 16)));
+            float last[4];
+            _mm_storeu_ps(last, words[4]);
+            _MM_TRANSPOSE4_PS(words[0], words[1], words[2], words[3]);
+            for (int k = 0; k < 4; k++)
+            {
+                char *vertex = reinterpret_cast<char *>(packed + k);
+                _mm_storeu_ps(reinterpret_cast<float *>(vertex), words[k]);
+                memcpy(vertex + 16, &last[k], 4);
+            }
+        }
+
+        // compact() four vertices at a time; returns how many it converted
+        inline size_t compact(const Vertex *vertices, size_t count, const VertexQuantization &quantization, CompactVertex *packed)
+        {
+            const __m128 offsetX = _mm_set1_ps(quantization.positionOffset.x), scaleX = _mm_set1_ps(quantization.positionScale.x);
+            const __m128 offsetY = _mm_set1_ps(quantization.positionOffset.y), scaleY = _mm_set1_ps(quantization.positionScale.y);
+            const __m128 offsetZ = _mm_set1_ps(quantization.positionOffset.z), scaleZ = _mm_set1_ps(quantization.positionScale.z);
+            const __m128 uvOffsetX = _mm_set1_ps(quantization.texCoordTransform.x), uvScaleX = _mm_set1_ps(quantization.texCoordTransform.z);
+            const __m128 uvOffsetY = _mm_set1_ps(quantization.texCoordTransform.y), uvScaleY = _mm_set1_ps(quantization.texCoordTransform.w);
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                const Vertex *vertex = vertices + i;
+                __m128 px, py, pz, nx, ny, nz, tx, ty, tz, bx, by, bz;
+                load(vertex, offsetof(Vertex, Position), px, py, pz);
+                load(vertex, offsetof(Vertex, Normal), nx, ny, nz);
+                load(vertex, offsetof(Vertex, Tangent), tx, ty, tz);
+                load(vertex, offsetof(Vertex, Bitangent), bx, by, bz);
+                __m128 uv01 = _mm_loadh_pi(_mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(&vertex[0].TexCoords)),
+                                           reinterpret_cast<const __m64 *>(&vertex[1].TexCoords));
+                __m128 uv23 = _mm_loadh_pi(_mm_loadl_pi(zero, reinterpret_cast<const __m64 *>(&vertex[2].TexCoords)),
+                                           reinterpret_cast<const __m64 *>(&vertex[3].TexCoords));
+                __m128 u = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 v = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+
+                normalize(nx, ny, nz, zero, one, zero);
+                normalize(tx, ty, tz, one, zero, zero);
+                // cross(normal, tangent), glm's order
+                __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(ty, nz));
+                __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(tz, nx));
+                __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(tx, ny));
+                normalize(bx, by, bz, cx, cy, cz);
+                __m128 handedness = select(_mm_cmplt_ps(dot(cx, cy, cz, bx, by, bz), zero), _mm_set1_ps(-1.0f), one);
+
+                __m128 normalU, normalV, tangentU, tangentV;
+                octahedral(nx, ny, nz, normalU, normalV);
+                octahedral(tx, ty, tz, tangentU, tangentV);
+
+                __m128i lanes[10] = {
+                    snorm16(_mm_div_ps(_mm_sub_ps(px, offsetX), scaleX)),
+                    snorm16(_mm_div_ps(_mm_sub_ps(py, offsetY), scaleY)),
+                    snorm16(_mm_div_ps(_mm_sub_ps(pz, offsetZ), scaleZ)),
+                    snorm16(handedness),
+                    snorm16(normalU), snorm16(normalV),
+                    unorm16(_mm_div_ps(_mm_sub_ps(u, uvOffsetX), uvScaleX)),
+                    unorm16(_mm_div_ps(_mm_sub_ps(v, uvOffsetY), uvScaleY)),
+                    snorm16(tangentU), snorm16(tangentV),
+                };
+                store(lanes, packed + i);
+            }
+            return i;
+        }
+    }
+#endif
+
+#ifdef VERTEX_CONVERT_AVX2
+    // the SSE2 kernel eight vertices wide; every function is compiled for AVX2 and only called when the CPU has it
+    namespace Avx2
+    {
+        __attribute__((target("avx2"))) inline void load(const Vertex *vertices, size_t fieldOffset, __m256 &x, __m256 &y, __m256 &z)
+        {
+            const char *base = reinterpret_cast<const char *>(vertices) + fieldOffset;
+            __m128 r[8];
+            for (int k = 0; k < 8; k++)
+                r[k] = _mm_loadu_ps(reinterpret_cast<const float *>(base + k * sizeof(Vertex)));
+            _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+            _MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+            x = _mm256_insertf128_ps(_mm256_castps128_ps256(r[0]), r[4], 1);
+            y = _mm256_insertf128_ps(_mm256_castps128_ps256(r[1]), r[5], 1);
+            z = _mm256_insertf128_ps(_mm256_castps128_ps256(r[2]), r[6], 1);
+        }
+
+        __attribute__((target("avx2"))) inline __m256 abs(__m256 v)
+        {
+            return _mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+        }
+
+        __attribute__((target("avx2"))) inline __m256 dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+        {
+            return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+        }
+
+        __attribute__((target("avx2"))) inline void normalize(__m256 &x, __m256 &y, __m256 &z, __m256 fx, __m256 fy, __m256 fz)
+        {
+            __m256 length = _mm256_sqrt_ps(dot(x, y, z, x, y, z));
+            __m256 valid = _mm256_and_ps(_mm256_cmp_ps(length, _mm256_set1_ps(1.0e-12f), _CMP_GT_OQ),
+                                         _mm256_cmp_ps(length, _mm256_set1_ps(FLT_MAX), _CMP_LE_OQ));
+            x = _mm256_blendv_ps(fx, _mm256_div_ps(x, length), valid);
+            y = _mm256_blendv_ps(fy, _mm256_div_ps(y, length), valid);
+            z = _mm256_blendv_ps(fz, _mm256_div_ps(z, length), valid);
+        }
+
+        __attribute__((target("avx2"))) inline void octahedral(__m256 x, __m256 y, __m256 z, __m256 &u, __m256 &v)
+        {
+            __m256 sum = _mm256_add_ps(_mm256_add_ps(abs(x), abs(y)), abs(z));
+            x = _mm256_div_ps(x, sum);
+            y = _mm256_div_ps(y, sum);
+            z = _mm256_div_ps(z, sum);
+            __m256 one = _mm256_set1_ps(1.0f), minusOne = _mm256_set1_ps(-1.0f), zero = _mm256_setzero_ps();
+            __m256 signX = _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(x, zero, _CMP_GE_OQ));
+            __m256 signY = _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(y, zero, _CMP_GE_OQ));
+            __m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+            u = _mm256_blendv_ps(x, _mm256_mul_ps(_mm256_sub_ps(one, abs(y)), signX), lower);
+            v = _mm256_blendv_ps(y, _mm256_mul_ps(_mm256_sub_ps(one, abs(x)), signY), lower);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i snorm16(__m256 v)
+        {
+            v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+            return _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(32767.0f)));
+        }
+        __attribute__((target("avx2"))) inline __m256i unorm16(__m256 v)
+        {
+            v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+            return _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(65535.0f)));
+        }
+
+        __attribute__((target("avx2"))) inline size_t compact(const Vertex *vertices, size_t count, const VertexQuantization &quantization,
+                                                              CompactVertex *packed)
+        {
+            const __m256 offsetX = _mm256_set1_ps(quantization.positionOffset.x), scaleX = _mm256_set1_ps(quantization.positionScale.x);
+            const __m256 offsetY = _mm256_set1_ps(quantization.positionOffset.y), scaleY = _mm256_set1_ps(quantization.positionScale.y);
+            const __m256 offsetZ = _mm256_set1_ps(quantization.positionOffset.z), scaleZ = _mm256_set1_ps(quantization.positionScale.z);
+            const __m256 uvOffsetX = _mm256_set1_ps(quantization.texCoordTransform.x), uvScaleX = _mm256_set1_ps(quantization.texCoordTransform.z);
+            const __m256 uvOffsetY = _mm256_set1_ps(quantization.texCoordTransform.y), uvScaleY = _mm256_set1_ps(quantization.texCoordTransform.w);
+            const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                const Vertex *vertex = vertices + i;
+                __m256 px, py, pz, nx, ny, nz, tx, ty, tz, bx, by, bz;
+                load(vertex, offsetof(Vertex, Position), px, py, pz);
+                load(vertex, offsetof(Vertex, Normal), nx, ny, nz);
+                load(vertex, offsetof(Vertex, Tangent), tx, ty, tz);
+                load(vertex, offsetof(Vertex, Bitangent), bx, by, bz);
+                alignas(32) float us[8], vs[8];
+                for (int k = 0; k < 8; k++)
+                {
+                    us[k] = vertex[k].TexCoords.x;
+                    vs[k] = vertex[k].TexCoords.y;
+                }
+                __m256 u = _mm256_load_ps(us), v = _mm256_load_ps(vs);
+
+                normalize(nx, ny, nz, zero, one, zero);
+                normalize(tx, ty, tz, one, zero, zero);
+                __m256 cx = _mm256_sub_ps(_mm256_mul_ps(ny, tz), _mm256_mul_ps(ty, nz));
+                __m256 cy = _mm256_sub_ps(_mm256_mul_ps(nz, tx), _mm256_mul_ps(tz, nx));
+                __m256 cz = _mm256_sub_ps(_mm256_mul_ps(nx, ty), _mm256_mul_ps(tx, ny));
+                normalize(bx, by, bz, cx, cy, cz);
+                __m256 handedness = _mm256_blendv_ps(one, _mm256_set1_ps(-1.0f), _mm256_cmp_ps(dot(cx, cy, cz, bx, by, bz), zero, _CMP_LT_OQ));
+
+                __m256 normalU, normalV, tangentU, tangentV;
+                octahedral(nx, ny, nz, normalU, normalV);
+                octahedral(tx, ty, tz, tangentU, tangentV);
+
+                __m256i lanes[10] = {
+                    snorm16(_mm256_div_ps(_mm256_sub_ps(px, offsetX), scaleX)),
+                    snorm16(_mm256_div_ps(_mm256_sub_ps(py, offsetY), scaleY)),
+                    snorm16(_mm256_div_ps(_mm256_sub_ps(pz, offsetZ), scaleZ)),
+                    snorm16(handedness),
+                    snorm16(normalU), snorm16(normalV),
+                    unorm16(_mm256_div_ps(_mm256_sub_ps(u, uvOffsetX), uvScaleX)),
+                    unorm16(_mm256_div_ps(_mm256_sub_ps(v, uvOffsetY), uvScaleY)),
+                    snorm16(tangentU), snorm16(tangentV),
+                };
+                __m128i low[10], high[10];
+                for (int lane = 0; lane < 10; lane++)
+                {
+                    low[lane] = _mm256_castsi256_si128(lanes[lane]);
+                    high[lane] = _mm256_extracti128_si256(lanes[lane], 1);
+                }
+                Sse2::store(low, packed + i);
+                Sse2::store(high, packed + i + 4);
+            }
+            return i;
+        }
+    }
+#endif
+
+    // quantizes `count` vertices into `packed` (see compactVertices in vertex_format.h for the encoding)
+    inline void compact(const Vertex *vertices, size_t count, const VertexQuantization &quantization, CompactVertex *packed,
+                        Kernel kernel = bestKernel())
+    {
+        if (!available(kernel))
+            kernel = KERNEL_SCALAR;
+        size_t done = 0;
+#ifdef VERTEX_CONVERT_AVX2
+        if (kernel == KERNEL_AVX2)
+            done = Avx2::compact(vertices, count, quantization, packed);
+#endif
+#ifdef __SSE2__
+        if (kernel != KERNEL_SCALAR)
+            done += Sse2::compact(vertices + done, count - done, quantization, packed + done);
+#endif
+        // the last few vertices, or all of them without SIMD
+        compactVertices(vertices + done, count - done, quantization, packed + done);
+    }
+}
+#endif
@@ -0,0 +1,144 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+#define MAX_BONE_INFLUENCE 4
+
+// Full-precision vertex as produced by the importer and stored in the mesh cache; also the GPU layout of skinned meshes
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+    //bone indexes which will influence this vertex
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    //weights from each bone
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// GPU vertex layouts. VERTEX_FULL uploads Vertex as is (88 bytes, all seven attributes); VERTEX_COMPACT uploads
+// CompactVertex (20 bytes) and is used for every model without skinning. Programs drawing compact meshes are compiled
+// with COMPACT_VERTEX defined, which makes models/common/vertexFormat.glsl decode the packed attributes.
+enum VertexLayout {
+    VERTEX_FULL,
+    VERTEX_COMPACT
+};
+
+// Quantized vertex:
+//   position   snorm16 x3 within the mesh bounding box; w holds the bitangent sign (+-1), the bitangent being
+//              rebuilt as cross(normal, tangent) * sign
+//   normal     octahedral encoding, snorm16 x2
+//   texCoords  unorm16 x2 within the mesh's UV range (so tiling UVs outside [0, 1] still fit)
+//   tangent    octahedral encoding, snorm16 x2
+struct CompactVertex {
+    int16_t  position[4];
+    int16_t  normal[2];
+    uint16_t texCoords[2];
+    int16_t  tangent[2];
+};
+
+// Per-mesh ranges the compact attributes are decoded with: position = packed * positionScale + positionOffset,
+// texCoords = packed * texCoordTransform.zw + texCoordTransform.xy
+struct VertexQuantization {
+    glm::vec3 positionScale, positionOffset;
+    glm::vec4 texCoordTransform;
+};
+
+// rounded to nearest, ties to even, like the SIMD conversions in vertex_convert.h
+inline int16_t packSnorm16(float value)
+{
+    return static_cast<int16_t>(std::nearbyint(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+inline uint16_t packUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::nearbyint(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+}
+
+// maps a unit vector onto the [-1, 1]^2 square: the octahedron |x| + |y| + |z| = 1 is unfolded with its lower half
+// folded over the diagonals
+inline glm::vec2 octahedralEncode(glm::vec3 n)
+{
+    n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+        e = glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    return e;
+}
+
+// the direction, or `fallback` for zero-length or non-finite input (meshes without UVs have no tangent frame)
+inline glm::vec3 safeDirection(const glm::vec3 &v, const glm::vec3 &fallback)
+{
+    float length = glm::length(v);
+    return std::isfinite(length) && length > 1.0e-12f ? v / length : fallback;
+}
+
+inline VertexQuantization quantizationFor(const vector<Vertex> &vertices)
+{
+    glm::vec3 low(0.0f), high(0.0f);
+    glm::vec2 uvLow(0.0f), uvHigh(1.0f);
+    if (!vertices.empty())
+    {
+        low = high = vertices[0].Position;
+        uvLow = uvHigh = vertices[0].TexCoords;
+    }
+    for (const Vertex &vertex : vertices)
+    {
+        low = glm::min(low, vertex.Position);
+        high = glm::max(high, vertex.Position);
+        uvLow = glm::min(uvLow, vertex.TexCoords);
+        uvHigh = glm::max(uvHigh, vertex.TexCoords);
+    }
+    VertexQuantization quantization;
+    quantization.positionOffset = (low + high) * 0.5f;
+    // a flat axis still needs a non-zero scale to divide by
+    quantization.positionScale = glm::max((high - low) * 0.5f, glm::vec3(1.0e-6f));
+    quantization.texCoordTransform = glm::vec4(uvLow, glm::max(uvHigh - uvLow, glm::vec2(1.0e-6f)));
+    return quantization;
+}
+
+// the scalar conversion, one vertex at a time; VertexConvert::compact runs it with SIMD where available
+inline void compactVertices(const Vertex *vertices, size_t count, const VertexQuantization &quantization, CompactVertex *packed)
+{
+    glm::vec2 uvOffset(quantization.texCoordTransform.x, quantization.texCoordTransform.y);
+    glm::vec2 uvScale(quantization.texCoordTransform.z, quantization.texCoordTransform.w);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        CompactVertex &out = packed[i];
+        glm::vec3 position = (vertex.Position - quantization.positionOffset) / quantization.positionScale;
+        glm::vec3 normal = safeDirection(vertex.Normal, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::vec3 tangent = safeDirection(vertex.Tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::vec3 bitangent = safeDirection(vertex.Bitangent, glm::cross(normal, tangent));
+        float handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+
+        out.position[0] = packSnorm16(position.x);
+        out.position[1] = packSnorm16(position.y);
+        out.position[2] = packSnorm16(position.z);
+        out.position[3] = packSnorm16(handedness);
+        glm::vec2 n = octahedralEncode(normal), t = octahedralEncode(tangent);
+        out.normal[0] = packSnorm16(n.x);
+        out.normal[1] = packSnorm16(n.y);
+        out.tangent[0] = packSnorm16(t.x);
+        out.tangent[1] = packSnorm16(t.y);
+        glm::vec2 uv = (vertex.TexCoords - uvOffset) / uvScale;
+        out.texCoords[0] = packUnorm16(uv.x);
+        out.texCoords[1] = packUnorm16(uv.y);
+    }
+}
+#endif
@@ -0,0 +1,143 @@
+// Offline texture converter: encodes images to block-compressed DDS files with a precomputed mip chain, written next
+// to each image as <name>.dds, which the model loader then reads instead of decoding the image (see src/dds.h).
+//
+//     TextureConvert [--bc1 | --bc3 | --bc5] [--fast] image...
+//
+// Without a format flag, images with any transparent pixel become BC3 and the others BC1. BC5 keeps only the red and
+// green channels (tangent-space normal maps). Each mip level is resampled from the level above with stb_image_resize,
+// whose Mitchell filter keeps distant wood grain a little sharper than the box filter glGenerateMipmap usually uses.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include "dds.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// one level of RGBA pixels in 4x4 blocks; edge blocks repeat the last row and column
+static vector<unsigned char> encodeLevel(const unsigned char *rgba, int width, int height, Dds::Format format, int mode)
+{
+    vector<unsigned char> encoded(Dds::levelSize(format, width, height));
+    unsigned char *block = encoded.data();
+    for (int y = 0; y < height; y += 4)
+        for (int x = 0; x < width; x += 4)
+        {
+            unsigned char pixels[16 * 4], channels[16 * 2];
+            for (int row = 0; row < 4; row++)
+                for (int column = 0; column < 4; column++)
+                {
+                    const unsigned char *pixel = rgba + (static_cast<size_t>(std::min(y + row, height - 1)) * width + std::min(x + column, width - 1)) * 4;
+                    memcpy(pixels + (row * 4 + column) * 4, pixel, 4);
+                    channels[(row * 4 + column) * 2] = pixel[0];
+                    channels[(row * 4 + column) * 2 + 1] = pixel[1];
+                }
+            if (format == Dds::BC5)
+                stb_compress_bc5_block(block, channels);
+            else
+                stb_compress_dxt_block(block, pixels, format == Dds::BC3, mode);
+            block += Dds::blockBytes(format);
+        }
+    return encoded;
+}
+
+static bool hasTransparency(const unsigned char *rgba, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++)
+        if (rgba[i * 4 + 3] != 255)
+            return true;
+    return false;
+}
+
+static const char *formatName(Dds::Format format)
+{
+    return format == Dds::BC1 ? "BC1" : format == Dds::BC3 ? "BC3" : "BC5";
+}
+
+static bool convert(const string &path, bool automatic, Dds::Format format, int mode)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int width, height, components;
+    unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+    if (!pixels)
+    {
+        std::cout << "ERROR::TEXTURE_CONVERT::NOT_LOADED: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+        return false;
+    }
+    if (automatic)
+        format = hasTransparency(pixels, static_cast<size_t>(width) * height) ? Dds::BC3 : Dds::BC1;
+
+    vector<vector<unsigned char>> levels;
+    vector<unsigned char> level(pixels, pixels + static_cast<size_t>(width) * height * 4), next;
+    stbi_image_free(pixels);
+    int levelWidth = width, levelHeight = height;
+    size_t encodedBytes = 0;
+    for (;;)
+    {
+        levels.push_back(encodeLevel(level.data(), levelWidth, levelHeight, format, mode));
+        encodedBytes += levels.back().size();
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        int nextWidth = std::max(1, levelWidth / 2), nextHeight = std::max(1, levelHeight / 2);
+        next.resize(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        stbir_resize_uint8(level.data(), levelWidth, levelHeight, 0, next.data(), nextWidth, nextHeight, 0, 4);
+        level.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    string output = Dds::pathFor(path);
+    if (!Dds::write(output, format, width, height, levels))
+    {
+        std::cout << "ERROR::TEXTURE_CONVERT::NOT_WRITTEN: " << output << std::endl;
+        return false;
+    }
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    // what the uncompressed path keeps on the GPU: the decoded components plus a generated chain
+    size_t rawBytes = static_cast<size_t>(width) * height * components * 4 / 3;
+    std::cout << output << ": " << width << "x" << height << " " << formatName(format) << ", " << levels.size() << " levels, "
+              << encodedBytes / 1024.0 << " KiB (" << rawBytes / 1024.0 << " KiB uncompressed) in " << milliseconds << " ms" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool automatic = true;
+    Dds::Format format = Dds::BC1;
+    int mode = STB_DXT_HIGHQUAL;
+    vector<string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--bc1" || argument == "--bc3" || argument == "--bc5")
+        {
+            automatic = false;
+            format = argument == "--bc1" ? Dds::BC1 : argument == "--bc3" ? Dds::BC3 : Dds::BC5;
+        }
+        else if (argument == "--fast")
+            mode = STB_DXT_NORMAL;
+        else
+            paths.push_back(argument);
+    }
+    if (paths.empty())
+    {
+        std::cout << "usage: TextureConvert [--bc1 | --bc3 | --bc5] [--fast] image..." << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (const string &path : paths)
+        if (!convert(path, automatic, format, mode))
+            failed++;
+    return failed == 0 ? 0 : 1;
+}